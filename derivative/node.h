@@ -73,7 +73,7 @@ enum NodeType {
 
 struct NodeData {
     NodeType type;
-    std::variant<const char*, Operator, double> value = 0;
+    std::variant<const char*, Operator, double> value = 0.0;
 };
 
 
@@ -118,7 +118,7 @@ struct Node {
         return *this;
     }
 
-    Node() : parent(nullptr) {}
+    Node() : data{NODE_UNDEFINED}, parent(nullptr) {}
 
     Node* init_new_child() {
         children.push_back(new Node());
@@ -153,7 +153,7 @@ struct Node {
 #define EQUAL(value1, value2) (fabs((value1) - (value2)) < EPS)
 
 
-#define MAKE_CONST(value) Node({NODE_CONST, (value)})
+#define MAKE_CONST(value) Node(NodeData{NODE_CONST, (double)(value)})
 #define MAKE_VAR(name) Node({NODE_VAR, name})
 
 template <Operator op, typename... Args>
@@ -10,6 +10,7 @@
 #include "node.h"
 #include "../proc/processor.h"
 #include "../proc/parser.h"
+#include "../proc/bytecode.h"
 
 
 class parser_exception : std::exception {
@@ -58,7 +59,7 @@ public:
 class Parser {
 private:
     Lexer& lexer_;
-    std::map<std::string, Node*> funcs;
+    std::map<std::string, size_t> funcs;       // number of arguments
 
     Node getG_() {
         auto p0 = lexer_.mark();
@@ -74,7 +75,8 @@ private:
             if (IS_OP(*node.children.back()) &&
                 OP(*node.children.back()) == OP_DECLARE &&
                 IS_UNDEFINED(*node.children.back()->children[1]))
-                    funcs[std::string(NAME(*node.children.back()->children[0]))] = node.children.back();
+                    funcs[std::string(NAME(*node.children.back()->children[0]))] =
+                        node.children.back()->children[1]->children.size();
 
             p0 = lexer_.mark();
             lexeme = lexer_.next_lexeme();
@@ -113,7 +115,7 @@ private:
             else if (!funcs.count(name))
                 throw parser_exception("function not declared");
             else
-                argnum = funcs[name]->children[1]->children.size();
+                argnum = funcs[name];
         }
 
         if (lexer_.next_lexeme().type != LT_L_PARANTHESIS) {
@@ -272,7 +274,7 @@ private:
         }
         lexer_.reset(p0);
 
-        return MAKE_OP<OP_DECLARE>(name, Node({NODE_UNDEFINED}, args), ans);
+        return MAKE_OP<OP_DECLARE>(name, Node(NodeData{NODE_UNDEFINED}, args), ans);
     }
 
     Node getCE_() {
@@ -560,12 +562,14 @@ private:
         if (lexer_.next_lexeme().type != LT_AS)
             throw parser_exception("as expected");
 
+        // the body may call the function itself
+        funcs[name_str] = args.size();
         auto body = getG_();
 
         if (lexer_.next_lexeme().type != LT_END)
             throw parser_exception("end expected");
 
-        return MAKE_OP<OP_DECLARE>(name, Node({NODE_UNDEFINED}, args), body);
+        return MAKE_OP<OP_DECLARE>(name, Node(NodeData{NODE_UNDEFINED}, args), body);
     }
 
 public:
@@ -588,10 +592,12 @@ public:
 std::vector<std::map<std::string, int>> locals;
 std::vector<size_t> cur_nargs;
 std::map<std::string, int> call_start;
+std::vector<int> cur_function;
 
 
-void generate_asm_CALL(Node*, FILE*);
-void generate_block(Node*, FILE*, int call_from = 0);
+void generate_asm_CALL(Node*, FILE*, unsigned char command = CMD_CALL);
+void generate_asm_RET(Node*, FILE*);
+void generate_block(Node*, FILE*);
 void generate_asm_EXPR(Node*, FILE*);
 void generate_asm_OP(Node*, FILE*);
 void generate_asm_VD(Node*, FILE*);
@@ -606,20 +612,18 @@ void generate_asm_EXPR(Node* expr, FILE* memstream) {
             case OP_##name: { \
                 for (auto i = 0; i < arg_num; ++i) \
                     if (IS_VAR(*expr->children[i])) { \
-                        fwrite(get_address(CMD_GET_LOCAL), 1, 1, memstream); \
-                        fwrite(get_address<double>(locals.back()[std::string(NAME(*expr->children[i]))]), \
-                               sizeof(double), 1, memstream); \
+                        emit_command(memstream, CMD_GET_LOCAL); \
+                        emit_int(memstream, locals.back()[std::string(NAME(*expr->children[i]))]); \
                     } \
                     else if (IS_CONST(*expr->children[i])) { \
-                        fwrite(get_address(CMD_PUSH), 1, 1, memstream); \
-                        fwrite(get_address<double>(0), sizeof(double), 1, memstream); \
-                        fwrite(&VALUE(*expr->children[i]), sizeof(double), 1, memstream); \
+                        emit_command(memstream, CMD_PUSH); \
+                        emit_double(memstream, VALUE(*expr->children[i])); \
                     } \
                     else if (IS_CALL(*expr->children[i])) \
                         generate_asm_CALL(expr->children[i], memstream); \
                     else \
                         generate_asm_EXPR(expr->children[i], memstream); \
-                fwrite(get_address(CMD_##proc_command), 1, 1, memstream); \
+                emit_command(memstream, CMD_##proc_command); \
                 break; \
             }
 #include "operators.h"
@@ -628,10 +632,13 @@ void generate_asm_EXPR(Node* expr, FILE* memstream) {
         }
     else if (IS_CALL(*expr))
         generate_asm_CALL(expr, memstream);
+    else if (IS_VAR(*expr)) {
+        emit_command(memstream, CMD_GET_LOCAL);
+        emit_int(memstream, locals.back()[std::string(NAME(*expr))]);
+    }
     else if (IS_CONST(*expr)) {
-        fwrite(get_address(CMD_PUSH), 1, 1, memstream);
-        fwrite(get_address<double>(0), sizeof(double), 1, memstream);
-        fwrite(&VALUE(*expr), sizeof(double), 1, memstream);
+        emit_command(memstream, CMD_PUSH);
+        emit_double(memstream, VALUE(*expr));
     }
     else
         throw parser_exception("wrong operator");
@@ -645,15 +652,15 @@ void generate_asm_OP(Node* op, FILE* memstream) {
                 if (!locals.back().count(name1)) \
                     throw parser_exception("variable has not been declared yet"); \
                 \
-                fwrite(get_address(CMD_GET_LOCAL), 1, 1, memstream); \
-                fwrite(get_address<double>(locals.back()[name1]), sizeof(double), 1, memstream); \
+                emit_command(memstream, CMD_GET_LOCAL); \
+                emit_int(memstream, locals.back()[name1]); \
                 \
                 generate_asm_EXPR(op->children[1], memstream); \
                 \
-                fwrite(get_address(CMD_##proc_command), 1, 1, memstream); \
+                emit_command(memstream, CMD_##proc_command); \
                 \
-                fwrite(get_address(CMD_SET_LOCAL), 1, 1, memstream); \
-                fwrite(get_address<double>(locals.back()[name1]), sizeof(double), 1, memstream); \
+                emit_command(memstream, CMD_SET_LOCAL); \
+                emit_int(memstream, locals.back()[name1]); \
                 break; \
             }
 #include "operators.h"
@@ -662,22 +669,16 @@ void generate_asm_OP(Node* op, FILE* memstream) {
                 auto cond = op->children[0];
                 generate_asm_EXPR(cond, memstream);
 
-                fwrite(get_address(CMD_PUSH), 1, 1, memstream);
-                fwrite(get_address<double>(0), sizeof(double), 1, memstream);
-                fwrite(get_address<double>(0), sizeof(double), 1, memstream);
-                fwrite(get_address(CMD_JE), 1, 1, memstream);
+                emit_command(memstream, CMD_PUSH);
+                emit_double(memstream, 0);
+                emit_command(memstream, CMD_JE);
             
                 auto label_place = ftell(memstream);
-                fwrite(get_address<double>(0), sizeof(double), 1, memstream);
+                emit_int(memstream, 0);
                 
                 generate_block(op->children[1], memstream);
 
-                auto last = ftell(memstream);
-
-                fseek(memstream, label_place, SEEK_SET);
-                fwrite(get_address<double>(last + strlen(SGN)), sizeof(double), 1, memstream);
-
-                fseek(memstream, last, SEEK_SET);
+                patch_int(memstream, label_place, ftell(memstream) + BYTECODE_HEADER_SIZE);
                 break;
             }
             case OP_WHILE: {
@@ -685,8 +686,8 @@ void generate_asm_OP(Node* op, FILE* memstream) {
 
                 generate_block(op->children[0], memstream);
 
-                fwrite(get_address(CMD_JMP), 1, 1, memstream);
-                fwrite(get_address<double>(start + strlen(SGN)), sizeof(double), 1, memstream);
+                emit_command(memstream, CMD_JMP);
+                emit_int(memstream, start + BYTECODE_HEADER_SIZE);
                 break;
             }
 
@@ -694,19 +695,18 @@ void generate_asm_OP(Node* op, FILE* memstream) {
         }
 }
 
-void generate_asm_CALL(Node* call, FILE* memstream) {
+void generate_asm_CALL(Node* call, FILE* memstream, unsigned char command) {
     std::string name = NAME(*call);
     // reverse!!
     for (auto it_child = call->children.rbegin(); it_child != call->children.rend(); ++it_child) {
         auto child = *it_child;
         if (IS_VAR(*child)) {
-            fwrite(get_address(CMD_GET_LOCAL), 1, 1, memstream);
-            fwrite(get_address<double>(locals.back()[std::string(NAME(*child))]), sizeof(double), 1, memstream);
+            emit_command(memstream, CMD_GET_LOCAL);
+            emit_int(memstream, locals.back()[std::string(NAME(*child))]);
         }
         else if (IS_CONST(*child)) {
-            fwrite(get_address(CMD_PUSH), 1, 1, memstream);
-            fwrite(get_address<double>(0), sizeof(double), 1, memstream);
-            fwrite(get_address<double>(VALUE(*child)), sizeof(double), 1, memstream);
+            emit_command(memstream, CMD_PUSH);
+            emit_double(memstream, VALUE(*child));
         }
         else if (IS_CALL(*child))
             generate_asm_CALL(child, memstream);
@@ -717,30 +717,52 @@ void generate_asm_CALL(Node* call, FILE* memstream) {
     if (false);
 #define DEF_BUILTIN_FUNC(mnemonic, nargs, proc_command) \
     else if (name == mnemonic) \
-        fwrite(get_address(CMD_##proc_command), 1, 1, memstream);
+        emit_command(memstream, CMD_##proc_command);
 #include "operators.h"
 #undef DEF_BUILTIN_FUNC
-    else if (!locals.back().count(name))
+    else if (!call_start.count(name))
         throw parser_exception("function has not been declared yet");
     else {
-        fwrite(get_address(CMD_CALL), 1, 1, memstream);
-        fwrite(get_address<double>(call_start[name]), sizeof(double), 1, memstream);
+        emit_command(memstream, command);
+        emit_int(memstream, call_start[name]);
     }
 }
 
+bool is_builtin(const std::string& name) {
+#define DEF_BUILTIN_FUNC(mnemonic, nargs, proc_command) \
+    if (name == mnemonic) \
+        return true;
+#include "operators.h"
+#undef DEF_BUILTIN_FUNC
+    return false;
+}
+
+// ret f(...) reuses the frame of the current function for f
+void generate_asm_RET(Node* value, FILE* memstream) {
+    if (IS_CALL(*value) && !is_builtin(NAME(*value))) {
+        generate_asm_CALL(value, memstream, CMD_TAILCALL);
+        return;
+    }
+
+    generate_asm_EXPR(value, memstream);
+    emit_command(memstream, CMD_RET);
+    emit_int(memstream, cur_function.back());
+}
+
 void generate_asm_MFD(Node* fd, FILE* memstream) {
     std::string name = NAME(*fd->children[0]);
     if (locals.back().count(name))
         throw parser_exception("function has already been declared");
     locals.back()[name] = locals.back().size() - cur_nargs.back();
 
-    fwrite(get_address(CMD_FD), 1, 1, memstream);
+    call_start[name] = ftell(memstream) + BYTECODE_HEADER_SIZE;
+    cur_function.push_back(call_start[name]);
+    emit_command(memstream, CMD_FD);
     auto nskip_offset = ftell(memstream);
 
-    fwrite(get_address<double>(0), sizeof(double), 1, memstream);
-    call_start[name] = ftell(memstream) + strlen(SGN);
-    fwrite(get_address<double>(0), sizeof(double), 1, memstream);
-    fwrite(get_address<double>(0), sizeof(double), 1, memstream);
+    emit_int(memstream, 0);
+    emit_int(memstream, 0);
+    emit_int(memstream, 0);
 
     locals.emplace_back();
     
@@ -749,18 +771,13 @@ void generate_asm_MFD(Node* fd, FILE* memstream) {
     for (auto i = 0u; i < n; ++i) 
         locals.back()[NAME(*fd->children[1]->children[i])] = -i-1;
     
-    generate_asm_EXPR(fd->children[2], memstream);
-    fwrite(get_address(CMD_RET), 1, 1, memstream);
-    fwrite(get_address<double>(call_start[name]), sizeof(double), 1, memstream);
-
-    auto from = ftell(memstream);
+    generate_asm_RET(fd->children[2], memstream);
 
-    fseek(memstream, nskip_offset, SEEK_SET);
-    fwrite(get_address<double>(from + strlen(SGN)), sizeof(double), 1, memstream);
-    fwrite(get_address<double>(n), sizeof(double), 1, memstream);
-    fwrite(get_address<double>(locals.back().size() - n), sizeof(double), 1, memstream);
-    fseek(memstream, from, SEEK_SET);
+    patch_int(memstream, nskip_offset, ftell(memstream) + BYTECODE_HEADER_SIZE);
+    patch_int(memstream, nskip_offset + sizeof(int32_t), n);
+    patch_int(memstream, nskip_offset + 2 * sizeof(int32_t), locals.back().size() - n);
 
+    cur_function.pop_back();
     cur_nargs.pop_back();
     locals.pop_back();  
 }
@@ -771,17 +788,17 @@ void generate_asm_FD(Node* fd, FILE* memstream) {
         throw parser_exception("function has already been declared");
     locals.back()[name] = locals.back().size() - cur_nargs.back();;
 
-    fwrite(get_address(CMD_FD), 1, 1, memstream);
+    call_start[name] = ftell(memstream) + BYTECODE_HEADER_SIZE;
+    cur_function.push_back(call_start[name]);
+    emit_command(memstream, CMD_FD);
     auto nskip_offset = ftell(memstream);
 
     // endfunc
-    fwrite(get_address<double>(0), sizeof(double), 1, memstream);
-    call_start[name] = ftell(memstream) + strlen(SGN);
-    
+    emit_int(memstream, 0);
     // nargs
-    fwrite(get_address<double>(0), sizeof(double), 1, memstream);
+    emit_int(memstream, 0);
     // nlocals
-    fwrite(get_address<double>(0), sizeof(double), 1, memstream);
+    emit_int(memstream, 0);
 
     locals.emplace_back();
     
@@ -791,17 +808,18 @@ void generate_asm_FD(Node* fd, FILE* memstream) {
         locals.back()[NAME(*fd->children[1]->children[i])] = -i-1;
     
     generate_block(fd->children[2], memstream);
-    fwrite(get_address(CMD_LEAVE), 1, 1, memstream);
-    fwrite(get_address<double>(call_start[name]), sizeof(double), 1, memstream);
-
-    auto from = ftell(memstream);
+    // a body that ends with ret or leave does not fall through
+    auto& body = fd->children[2]->children;
+    if (body.empty() || !IS_OP(*body.back()) || (OP(*body.back()) != OP_RET && OP(*body.back()) != OP_LEAVE)) {
+        emit_command(memstream, CMD_LEAVE);
+        emit_int(memstream, call_start[name]);
+    }
 
-    fseek(memstream, nskip_offset, SEEK_SET);
-    fwrite(get_address<double>(from + strlen(SGN)), sizeof(double), 1, memstream);
-    fwrite(get_address<double>(n), sizeof(double), 1, memstream);
-    fwrite(get_address<double>(locals.back().size() - n), sizeof(double), 1, memstream);
-    fseek(memstream, from, SEEK_SET);
+    patch_int(memstream, nskip_offset, ftell(memstream) + BYTECODE_HEADER_SIZE);
+    patch_int(memstream, nskip_offset + sizeof(int32_t), n);
+    patch_int(memstream, nskip_offset + 2 * sizeof(int32_t), locals.back().size() - n);
 
+    cur_function.pop_back();
     cur_nargs.pop_back();
     locals.pop_back();
 }
@@ -815,12 +833,12 @@ void generate_asm_VD(Node* vd, FILE* memstream) {
 
     generate_asm_EXPR(vd->children[1], memstream);
     
-    fwrite(get_address(CMD_SET_LOCAL), 1, 1, memstream);
-    fwrite(get_address<double>(locals.back()[name]), sizeof(double), 1, memstream);
+    emit_command(memstream, CMD_SET_LOCAL);
+    emit_int(memstream, locals.back()[name]);
 }
 
 
-void generate_block(Node* root, FILE* memstream, int call_from) {
+void generate_block(Node* root, FILE* memstream) {
     for (auto child : root->children)
         if (IS_OP(*child)) {
             if (OP(*child) == OP_DECLARE) {
@@ -834,14 +852,11 @@ void generate_block(Node* root, FILE* memstream, int call_from) {
                     generate_asm_VD(child, memstream);
             }
             else if (OP(*child) == OP_LEAVE) {
-                fwrite(get_address(CMD_LEAVE), 1, 1, memstream);
-                fwrite(get_address<double>(call_from + strlen(SGN)), sizeof(double), 1, memstream);
-            }
-            else if (OP(*child) == OP_RET) {
-                generate_asm_EXPR(child->children[0], memstream);
-                fwrite(get_address(CMD_RET), 1, 1, memstream);
-                fwrite(get_address<double>(call_from + strlen(SGN)), sizeof(double), 1, memstream);
+                emit_command(memstream, CMD_LEAVE);
+                emit_int(memstream, cur_function.back());
             }
+            else if (OP(*child) == OP_RET)
+                generate_asm_RET(child->children[0], memstream);
             else
                 generate_asm_OP(child, memstream);
         }
@@ -864,38 +879,33 @@ void generate_asm(Node* root) {
         perror("a.dk");
         exit(1);
     }
-    fprintf(out, SGN);
+    emit_header(out);
 
     locals.emplace_back();
     cur_nargs.push_back(0);
+    cur_function.push_back(begin + BYTECODE_HEADER_SIZE);
 
     // fd
-    fwrite(get_address(CMD_FD), 1, 1, memstream);
+    emit_command(memstream, CMD_FD);
     auto offset = ftell(memstream);
 
     // endfunc
-    fwrite(get_address<double>(0), sizeof(double), 1, memstream);
+    emit_int(memstream, 0);
     // nargs
-    fwrite(get_address<double>(0), sizeof(double), 1, memstream);
+    emit_int(memstream, 0);
     // nlocals
-    fwrite(get_address<double>(0), sizeof(double), 1, memstream);
+    emit_int(memstream, 0);
 
     generate_block(root, memstream);
-    fwrite(get_address(CMD_LEAVE), 1, 1, memstream);
-    fwrite(get_address<double>(strlen(SGN) + 1 + sizeof(double)), sizeof(double), 1, memstream);
-
-    auto from = ftell(memstream);
+    emit_command(memstream, CMD_LEAVE);
+    emit_int(memstream, begin + BYTECODE_HEADER_SIZE);
 
     // update
-    fseek(memstream, offset, SEEK_SET);
-    fwrite(get_address<double>(from - begin + strlen(SGN)), sizeof(double), 1, memstream);
-    fwrite(get_address<double>(0), sizeof(double), 1, memstream);
-    fwrite(get_address<double>(locals.back().size()), sizeof(double), 1, memstream);
-
-    fseek(memstream, from, SEEK_SET);
+    patch_int(memstream, offset, ftell(memstream) - begin + BYTECODE_HEADER_SIZE);
+    patch_int(memstream, offset + 2 * sizeof(int32_t), locals.back().size());
 
-    fwrite(get_address(CMD_CALL), 1, 1, memstream);
-    fwrite(get_address<double>(strlen(SGN) + 1 + sizeof(double)), sizeof(double), 1, memstream);
+    emit_command(memstream, CMD_CALL);
+    emit_int(memstream, begin + BYTECODE_HEADER_SIZE);
 
     fclose(memstream);
  
@@ -0,0 +1,256 @@
+#include "list.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <deque>
+#include <list>
+#include <random>
+#include <utility>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+
+// every workload runs in its own forked process, so ru_maxrss is the peak of that workload alone
+
+
+template <size_t N>
+struct Payload {
+    char data[N];
+
+    Payload(char c = 0) {
+        memset(data, c, N);
+    }
+};
+
+
+class CacheMissesCounter {
+private:
+    int fd_;
+
+public:
+    CacheMissesCounter() {
+        perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        fd_ = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd_ != -1) {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    ~CacheMissesCounter() {
+        if (fd_ != -1)
+            close(fd_);
+    }
+
+    // -1 if the counter is not available (no permissions, no PMU in a VM, ...)
+    long long read_value() {
+        long long value = -1;
+        if (fd_ == -1 || read(fd_, &value, sizeof(value)) != sizeof(value))
+            return -1;
+        return value;
+    }
+};
+
+
+template <typename T>
+void erase_at(List<T>& list, typename List<T>::iterator& it) {
+    it = list.remove(it);
+}
+
+template <typename Container>
+void erase_at(Container& container, typename Container::iterator& it) {
+    it = container.erase(it);
+}
+
+
+template <typename T>
+void pull(List<T>& list) {
+    list.pull();
+}
+
+template <typename Container>
+void pull(Container&) {}
+
+
+template <typename Container>
+long long traverse(Container& container) {
+    long long sum = 0;
+    for (auto it = container.begin(); it != container.end(); ++it)
+        sum += it->data[0];
+    return sum;
+}
+
+
+// fills the container in a random order, so that neighbours are far from each other in memory
+template <typename Container>
+void fill_shuffled(Container& container, size_t n, std::mt19937& gen) {
+    for (size_t i = 0; i < n; ++i) {
+        auto it = container.begin();
+        for (size_t steps = gen() % 8; steps && it != container.end(); --steps)
+            ++it;
+        container.insert(it, typename Container::value_type(i));
+    }
+}
+
+
+template <typename Container>
+long long push_pop_back(size_t n) {
+    Container container;
+    for (size_t i = 0; i < n; ++i)
+        container.push_back(typename Container::value_type(i));
+    for (size_t i = 0; i < n; ++i)
+        container.pop_back();
+    return container.size();
+}
+
+template <typename Container>
+long long push_pop_front(size_t n) {
+    Container container;
+    for (size_t i = 0; i < n; ++i)
+        container.push_front(typename Container::value_type(i));
+    for (size_t i = 0; i < n; ++i)
+        container.pop_front();
+    return container.size();
+}
+
+template <typename Container>
+long long random_insert_remove(size_t n) {
+    std::mt19937 gen(24);
+    Container container;
+    for (size_t i = 0; i < n; ++i)
+        container.push_back(typename Container::value_type(i));
+
+    auto it = container.begin();
+    for (size_t i = 0; i < 2 * n; ++i) {
+        for (size_t steps = gen() % 16; steps; --steps)
+            if (++it == container.end())
+                it = container.begin();
+
+        if (gen() % 2)
+            it = container.insert(it, typename Container::value_type(i));
+        else if (container.size() > 1) {
+            erase_at(container, it);
+            if (it == container.end())
+                it = container.begin();
+        }
+    }
+    return container.size();
+}
+
+template <typename Container>
+long long traverse_fragmented(size_t n) {
+    std::mt19937 gen(24);
+    Container container;
+    fill_shuffled(container, n, gen);
+
+    long long sum = 0;
+    for (int i = 0; i < 100; ++i)
+        sum += traverse(container);
+    return sum;
+}
+
+// the same, but after List::pull() (no-op for the standard containers)
+template <typename Container>
+long long traverse_pulled(size_t n) {
+    std::mt19937 gen(24);
+    Container container;
+    fill_shuffled(container, n, gen);
+    pull(container);
+
+    long long sum = 0;
+    for (int i = 0; i < 100; ++i)
+        sum += traverse(container);
+    return sum;
+}
+
+template <typename Container>
+long long copy_move(size_t n) {
+    Container container;
+    for (size_t i = 0; i < n; ++i)
+        container.push_back(typename Container::value_type(i));
+
+    long long sum = 0;
+    for (int i = 0; i < 10; ++i) {
+        Container copy(container);
+        Container moved(std::move(copy));
+        sum += moved.size();
+    }
+    return sum;
+}
+
+
+// note: fill_shuffled and the setup loops are measured too, they are the same for all containers
+template <typename Container>
+void measure(const char* container_name, const char* workload_name,
+             long long (*workload)(size_t), size_t n) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid) {
+        waitpid(pid, nullptr, 0);
+        return;
+    }
+
+    CacheMissesCounter counter;
+    auto begin = std::chrono::steady_clock::now();
+    volatile long long result = workload(n);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+    long long misses = counter.read_value();
+    (void)result;
+
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("%-22s %-12s %8zu %12.2f %10ld", workload_name, container_name,
+           sizeof(typename Container::value_type), elapsed.count(), usage.ru_maxrss);
+    if (misses >= 0)
+        printf(" %14lld\n", misses);
+    else
+        printf(" %14s\n", "n/a");
+
+    fflush(stdout);
+    _exit(0);
+}
+
+
+template <size_t N>
+void run_all(size_t scale) {
+    using T = Payload<N>;
+
+#define MEASURE(workload, n) \
+    measure<List<T>>("List", #workload, workload<List<T>>, n); \
+    measure<std::list<T>>("std::list", #workload, workload<std::list<T>>, n); \
+    measure<std::deque<T>>("std::deque", #workload, workload<std::deque<T>>, n);
+
+    MEASURE(push_pop_back, 1000000 * scale)
+    MEASURE(push_pop_front, 1000000 * scale)
+    MEASURE(random_insert_remove, 10000 * scale)
+    MEASURE(traverse_fragmented, 20000 * scale)
+    MEASURE(traverse_pulled, 20000 * scale)
+    MEASURE(copy_move, 100000 * scale)
+
+#undef MEASURE
+}
+
+
+int main(int argc, char** argv) {
+    size_t scale = argc > 1 ? atoi(argv[1]) : 1;
+
+    printf("%-22s %-12s %8s %12s %10s %14s\n",
+           "workload", "container", "payload", "time (ms)", "RSS (KB)", "cache misses");
+
+    run_all<8>(scale);
+    run_all<64>(scale);
+    run_all<256>(scale);
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <stdint.h>
+
+
+//multi-producer multi-consumer FIFO on the same blocks-of-nodes-linked-by-indices design as List:
+//free nodes are kept in a lock-free (Treiber) stack, the queue itself is Michael-Scott's one.
+//Both are linked by 32-bit indices tagged with 32-bit counters to defeat ABA,
+//blocks are never freed or moved until the destructor, so a node index stays dereferenceable forever.
+template <typename T>
+class ConcurrentQueue {
+    //dequeue reads the value before it knows the node is still its own, so T must tolerate torn copies
+    static_assert(std::is_trivially_copyable<T>::value, "ConcurrentQueue needs trivially copyable T");
+
+private:
+    struct Node {
+        std::atomic<uint64_t> next;
+        T data;
+    };
+
+    const static size_t __BLOCK_SIZE__ = 1024;
+    const static size_t __MAX_BLOCKS__ = 1 << 16;
+
+    using Block = std::array<Node, __BLOCK_SIZE__>;
+
+    std::atomic<Block*>* blocks_;
+    std::atomic<size_t> nblocks_;
+    std::mutex grow_mutex_;
+
+    alignas(64) std::atomic<uint64_t> head_;
+    alignas(64) std::atomic<uint64_t> tail_;
+    alignas(64) std::atomic<uint64_t> first_free_;
+
+
+    static uint64_t pack_(uint32_t index, uint32_t tag) {
+        return (uint64_t)tag << 32 | index;
+    }
+
+    static uint32_t index_(uint64_t tagged) {
+        return (uint32_t)tagged;
+    }
+
+    static uint32_t tag_(uint64_t tagged) {
+        return (uint32_t)(tagged >> 32);
+    }
+
+
+    Node& node_at_(uint32_t index) const {
+        return (*blocks_[index / __BLOCK_SIZE__].load(std::memory_order_acquire))[index % __BLOCK_SIZE__];
+    }
+
+
+    //pushes the chain first..last (already linked through next) onto the free stack
+    void free_chain_(uint32_t first, uint32_t last) {
+        uint32_t tag = tag_(node_at_(last).next.load(std::memory_order_relaxed)) + 1;
+        uint64_t top = first_free_.load(std::memory_order_relaxed);
+        do {
+            node_at_(last).next.store(pack_(index_(top), tag), std::memory_order_relaxed);
+        } while (!first_free_.compare_exchange_weak(top, pack_(first, tag_(top) + 1),
+                                                    std::memory_order_release,
+                                                    std::memory_order_relaxed));
+    }
+
+
+    //adds a block and gives its nodes to the free stack; index 0 (block 0) is reserved for null
+    void grow_() {
+        std::lock_guard<std::mutex> lock(grow_mutex_);
+        if (index_(first_free_.load(std::memory_order_acquire)))
+            return;
+
+        size_t block_index = nblocks_.load(std::memory_order_relaxed);
+        if (block_index == __MAX_BLOCKS__)
+            throw std::length_error("ConcurrentQueue is full");
+
+        Block* block = new Block();
+        uint32_t i0 = block_index * __BLOCK_SIZE__;
+        for (uint32_t i = 0; i < __BLOCK_SIZE__; ++i)
+            (*block)[i].next.store(pack_(i0 + i + 1, 0), std::memory_order_relaxed);
+
+        blocks_[block_index].store(block, std::memory_order_release);
+        nblocks_.store(block_index + 1, std::memory_order_release);
+
+        uint32_t first = block_index ? i0 : 1;
+        free_chain_(first, i0 + __BLOCK_SIZE__ - 1);
+    }
+
+
+    uint32_t allocate_() {
+        while (true) {
+            uint64_t top = first_free_.load(std::memory_order_acquire);
+            if (!index_(top)) {
+                grow_();
+                continue;
+            }
+
+            //may read a node another thread has just taken, but then the tag has moved on and CAS fails
+            uint64_t next = node_at_(index_(top)).next.load(std::memory_order_relaxed);
+            if (first_free_.compare_exchange_weak(top, pack_(index_(next), tag_(top) + 1),
+                                                  std::memory_order_acquire,
+                                                  std::memory_order_relaxed))
+                return index_(top);
+        }
+    }
+
+
+public:
+    ConcurrentQueue()
+        : blocks_(new std::atomic<Block*>[__MAX_BLOCKS__]()), nblocks_(0),
+          head_(0), tail_(0), first_free_(0) {
+            uint32_t dummy = allocate_();
+            node_at_(dummy).next.store(0, std::memory_order_relaxed);
+            head_.store(pack_(dummy, 0), std::memory_order_relaxed);
+            tail_.store(pack_(dummy, 0), std::memory_order_relaxed);
+        }
+
+
+    ~ConcurrentQueue() {
+        for (size_t i = 0; i < nblocks_.load(); ++i)
+            delete blocks_[i].load();
+        delete[] blocks_;
+    }
+
+
+    ConcurrentQueue(const ConcurrentQueue&) = delete;
+    ConcurrentQueue(ConcurrentQueue&&) = delete;
+    ConcurrentQueue& operator=(const ConcurrentQueue&) = delete;
+    ConcurrentQueue& operator=(ConcurrentQueue&&) = delete;
+
+
+    //throws std::length_error when all __MAX_BLOCKS__ blocks are taken, the queue stays as it was
+    void push_back(const T& item) {
+        uint32_t index = allocate_();
+        Node& node = node_at_(index);
+
+        node.data = item;
+        node.next.store(pack_(0, tag_(node.next.load(std::memory_order_relaxed)) + 1),
+                        std::memory_order_relaxed);
+
+        while (true) {
+            uint64_t tail = tail_.load(std::memory_order_acquire);
+            uint64_t next = node_at_(index_(tail)).next.load(std::memory_order_acquire);
+
+            if (tail != tail_.load(std::memory_order_acquire))
+                continue;
+
+            if (index_(next)) {
+                //tail is lagging behind, help the other producer
+                tail_.compare_exchange_weak(tail, pack_(index_(next), tag_(tail) + 1),
+                                            std::memory_order_release, std::memory_order_relaxed);
+                continue;
+            }
+
+            if (node_at_(index_(tail)).next.compare_exchange_weak(next, pack_(index, tag_(next) + 1),
+                                                                 std::memory_order_release,
+                                                                 std::memory_order_relaxed)) {
+                tail_.compare_exchange_strong(tail, pack_(index, tag_(tail) + 1),
+                                              std::memory_order_release, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+
+    //false if the queue was empty
+    bool pop_front(T& item) {
+        while (true) {
+            uint64_t head = head_.load(std::memory_order_acquire);
+            uint64_t tail = tail_.load(std::memory_order_acquire);
+            uint64_t next = node_at_(index_(head)).next.load(std::memory_order_acquire);
+
+            if (head != head_.load(std::memory_order_acquire))
+                continue;
+
+            if (index_(head) == index_(tail)) {
+                if (!index_(next))
+                    return false;
+
+                tail_.compare_exchange_weak(tail, pack_(index_(next), tag_(tail) + 1),
+                                            std::memory_order_release, std::memory_order_relaxed);
+                continue;
+            }
+
+            T value = node_at_(index_(next)).data;
+            if (head_.compare_exchange_weak(head, pack_(index_(next), tag_(head) + 1),
+                                            std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                item = value;
+                free_chain_(index_(head), index_(head));
+                return true;
+            }
+        }
+    }
+
+
+    //exact only when nobody is pushing or popping
+    bool empty() const {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        return !index_(node_at_(index_(head)).next.load(std::memory_order_acquire));
+    }
+};
@@ -1,23 +1,66 @@
+#pragma once
+
  #include <vector>
 #include <array>
 #include <iterator>
 #include <cassert>
 #include <type_traits>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+
+
+//refers to a node of a List; stays checkable after the node is removed and its slot is reused
+struct ListHandle {
+    uint32_t index = 0;
+    uint32_t generation = 0;
+
+    bool operator==(const ListHandle& another) const {
+        return index == another.index && generation == another.generation;
+    }
+
+    bool operator!=(const ListHandle& another) const {
+        return !(*this == another);
+    }
+};
+
+namespace std {
+    template <>
+    struct hash<ListHandle> {
+        size_t operator()(const ListHandle& handle) const {
+            return hash<uint64_t>()((uint64_t)handle.generation << 32 | handle.index);
+        }
+    };
+}
+
+
+template <typename K, typename V, typename Hash>
+class LruCache;
 
 
 template <typename T>
 class List {
+    template <typename K, typename V, typename Hash>
+    friend class LruCache;
+
 private:
     struct Node {
         size_t next, prev;
+        uint32_t generation;
         T data;
     };
 
     const static size_t __BLOCK_SIZE__ = 100;
     
     using Block = std::array<Node, __BLOCK_SIZE__>;
+
+    // bit i of block's bitmap is set iff node i of the block holds an element
+    using Bitmap = std::array<uint64_t, (__BLOCK_SIZE__ + 63) / 64>;
     
     std::vector<Block>* buffer_ptr_;
+    std::vector<Bitmap> occupied_;
     
     size_t size_;
     size_t first_free_index_;
@@ -58,6 +101,40 @@ private:
     }
 
 
+    static uint64_t bit_(size_t index) {
+        return uint64_t(1) << (index % __BLOCK_SIZE__ % 64);
+    }
+
+    template <typename Bitmaps>
+    static auto& word_(Bitmaps& bitmaps, size_t index) {
+        return bitmaps[index / __BLOCK_SIZE__][index % __BLOCK_SIZE__ / 64];
+    }
+
+    void occupy_(size_t index) {
+        word_(occupied_, index) |= bit_(index);
+    }
+
+    void release_(size_t index) {
+        word_(occupied_, index) &= ~bit_(index);
+    }
+
+
+    // calls f(index) for every node of blocks [first_block, last_block) set in bitmaps, in physical order
+    template <typename F>
+    static void sweep_bitmaps_(const std::vector<Bitmap>& bitmaps, size_t first_block, size_t last_block, F&& f) {
+        for (size_t block = first_block; block < last_block; ++block)
+            for (size_t word = 0; word < bitmaps[block].size(); ++word)
+                for (uint64_t bits = bitmaps[block][word]; bits; bits &= bits - 1)
+                    f(block * __BLOCK_SIZE__ + word * 64 + __builtin_ctzll(bits));
+    }
+
+    // calls f(index) for every used node of blocks [first_block, last_block) in physical order
+    template <typename F>
+    void sweep_blocks_(size_t first_block, size_t last_block, F&& f) const {
+        sweep_bitmaps_(occupied_, first_block, last_block, std::forward<F>(f));
+    }
+
+
     void init_block_(size_t block_index) {
         size_t i0 = block_index * __BLOCK_SIZE__;
         for (size_t i = 0; i < __BLOCK_SIZE__; ++i) {
@@ -72,6 +149,7 @@ private:
     void expand_if_necessary_() {
         if (!first_free_index_) {
             buffer_ptr_->push_back(Block{});
+            occupied_.emplace_back();
             init_block_(buffer_ptr_->size() - 1);
             first_free_index_ = (buffer_ptr_->size() - 1) * __BLOCK_SIZE__;
         }
@@ -83,6 +161,7 @@ private:
         expand_if_necessary_();
 
         data_(first_free_index_) = T(std::forward<U>(what));
+        occupy_(first_free_index_);
 
         auto next_free_index = next_index_(first_free_index_);
 
@@ -106,8 +185,10 @@ private:
 
     template <typename U>
     void insert_(size_t before_which_index, U&& what) {
-        if (before_which_index == 0)
-            push_back_(what);
+        if (before_which_index == 0) {
+            push_back_(std::forward<U>(what));
+            return;
+        }
 
         expand_if_necessary_();
 
@@ -117,6 +198,7 @@ private:
             *head_index_ = first_free_index_;
 
         data_(first_free_index_) = T(std::forward<U>(what));
+        occupy_(first_free_index_);
         
         next_index_(first_free_index_) = before_which_index;
         prev_index_(first_free_index_) = prev_index_(before_which_index);
@@ -134,20 +216,36 @@ private:
     }
 
 
-    T remove_(size_t index) {
+    void unlink_(size_t index) {
         if (index == *head_index_)
             *head_index_ = next_index_(index);
         if (index == *tail_index_)
             *tail_index_ = prev_index_(index);
 
-        T removed_value = data_(index);
-
         if (prev_index_(index))
             next_index_(prev_index_(index)) = next_index_(index);
 
         if (next_index_(index))
             prev_index_(next_index_(index)) = prev_index_(index);
+    }
+
+
+    void link_front_(size_t index) {
+        prev_index_(index) = 0;
+        next_index_(index) = *head_index_;
+
+        if (*head_index_)
+            prev_index_(*head_index_) = index;
+        else
+            *tail_index_ = index;
+
+        *head_index_ = index;
+    }
+
 
+    //gives a node that is already unlinked (and released) back to the free chain
+    void free_(size_t index) {
+        ++node_at_(index).generation;
 
         next_index_(index) = first_free_index_;
         prev_index_(index) = 0;
@@ -156,11 +254,129 @@ private:
         first_free_index_ = index;
 
         --size_;
+    }
+
+
+    //unlinks the node and gives it back to the free chain, the value stays where it was
+    void erase_(size_t index) {
+        unlink_(index);
+        release_(index);
+        free_(index);
+    }
+
 
+    T remove_(size_t index) {
+        T removed_value = data_(index);
+        erase_(index);
         return removed_value;
     }
 
 
+    void erase_range_(size_t first, size_t last) {
+        if (first == last)
+            return;
+
+        size_t before = prev_index_(first);
+
+        for (size_t index = first; index != last; ) {
+            size_t next = next_index_(index);
+            release_(index);
+            free_(index);
+            index = next;
+        }
+
+        if (before)
+            next_index_(before) = last;
+        else
+            *head_index_ = last;
+
+        if (last)
+            prev_index_(last) = before;
+        else
+            *tail_index_ = before;
+    }
+
+
+    //erases the nodes set in doomed (already released from occupied_):
+    //survivors are relinked in one logical pass, then the doomed slots are freed in physical order
+    void erase_marked_(const std::vector<Bitmap>& doomed) {
+        size_t last_kept = 0;
+        for (size_t index = *head_index_; index; index = next_index_(index)) {
+            if (word_(doomed, index) & bit_(index))
+                continue;
+
+            prev_index_(index) = last_kept;
+            if (last_kept)
+                next_index_(last_kept) = index;
+            else
+                *head_index_ = index;
+            last_kept = index;
+        }
+
+        if (last_kept)
+            next_index_(last_kept) = 0;
+        else
+            *head_index_ = 0;
+        *tail_index_ = last_kept;
+
+        sweep_bitmaps_(doomed, 0, doomed.size(), [&](size_t index) { free_(index); });
+    }
+
+
+    ListHandle handle_(size_t index) const {
+        assert(index <= UINT32_MAX);
+        return index ? ListHandle{(uint32_t)index, node_at_(index).generation} : ListHandle{};
+    }
+
+
+    //links [first, last) before the node before_which_index (0 - to the end) in one pass,
+    //returns index of the first inserted node (before_which_index if the range is empty)
+    template <typename InputIt>
+    size_t insert_range_(size_t before_which_index, InputIt first, InputIt last) {
+        using category = typename std::iterator_traits<InputIt>::iterator_category;
+        if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value)
+            reserve(size_ + std::distance(first, last));
+
+        size_t run_head = 0;
+        size_t run_tail = before_which_index ? prev_index_(before_which_index) : *tail_index_;
+
+        for (; first != last; ++first) {
+            expand_if_necessary_();
+
+            size_t index = first_free_index_;
+            first_free_index_ = next_index_(index);
+
+            data_(index) = T(*first);
+            occupy_(index);
+
+            prev_index_(index) = run_tail;
+            if (run_tail)
+                next_index_(run_tail) = index;
+            else
+                *head_index_ = index;
+
+            if (!run_head)
+                run_head = index;
+            run_tail = index;
+
+            ++size_;
+        }
+
+        if (!run_head)
+            return before_which_index;
+
+        next_index_(run_tail) = before_which_index;
+        if (before_which_index)
+            prev_index_(before_which_index) = run_tail;
+        else
+            *tail_index_ = run_tail;
+
+        prev_index_(first_free_index_) = 0;
+
+        return run_head;
+    }
+
+
     template <typename Dummy = void>
     static typename std::enable_if<std::is_class<T>::value, Dummy>::type dump_(const T& t, 
                                                                                FILE* file, 
@@ -271,7 +487,7 @@ private:
 
 public:
     List()
-        : buffer_ptr_(new std::vector<Block>(1)), size_(0), 
+        : buffer_ptr_(new std::vector<Block>(1)), occupied_(1), size_(0), 
           first_free_index_(1), head_index_(new size_t(0)), tail_index_(new size_t(0)) {
             init_block_(0);
             next_index_(0) = 0;
@@ -286,7 +502,7 @@ public:
 
 
     List(const List& another)
-        : buffer_ptr_(new std::vector<Block>()), size_(another.size()),
+        : buffer_ptr_(new std::vector<Block>()), occupied_(another.occupied_), size_(another.size()),
           first_free_index_(another.first_free_index_),
           head_index_(new size_t(*another.head_index_)), tail_index_(new size_t(*another.tail_index_)) {
             for (size_t i = 0; i < another.buffer_ptr_->size(); ++i)
@@ -294,7 +510,7 @@ public:
           }
 
     List(List&& another)
-        : buffer_ptr_(new std::vector<Block>()), size_(another.size()),
+        : buffer_ptr_(new std::vector<Block>()), occupied_(another.occupied_), size_(another.size()),
           first_free_index_(another.first_free_index_),
           head_index_(new size_t(*another.head_index_)), tail_index_(new size_t(*another.tail_index_)) {
             for (size_t i = 0; i < another.buffer_ptr_->size(); ++i)
@@ -337,7 +553,7 @@ public:
 
 
     void pop_back() {
-        remove_(*tail_index_);
+        erase_(*tail_index_);
     }
 
 
@@ -351,7 +567,7 @@ public:
 
 
     void pop_front() {
-        remove_(*head_index_);
+        erase_(*head_index_);
     }
 
 
@@ -382,6 +598,7 @@ public:
         expand_if_necessary_();
 
         data_(first_free_index_) = T(std::forward<Args>(args)...);
+        occupy_(first_free_index_);
         
         auto next_free_index = next_index_(first_free_index_);
         next_index_(first_free_index_) = 0;
@@ -408,6 +625,7 @@ public:
         expand_if_necessary_();
 
         data_(first_free_index_) = T(std::forward<Args>(args)...);
+        occupy_(first_free_index_);
         
         auto next_free_index = next_index_(first_free_index_);
         prev_index_(first_free_index_) = 0;
@@ -434,12 +652,67 @@ public:
     }
 
 
+    size_t capacity() const {
+        return __BLOCK_SIZE__ * buffer_ptr_->size() - 1;
+    }
+
+
+    //allocates all the blocks needed to hold n elements at once and threads them into the free chain
+    void reserve(size_t n) {
+        if (n <= capacity())
+            return;
+
+        size_t old_nblocks = buffer_ptr_->size();
+        size_t new_nblocks = (n + __BLOCK_SIZE__) / __BLOCK_SIZE__;
+
+        buffer_ptr_->resize(new_nblocks);
+        occupied_.resize(new_nblocks);
+
+        for (size_t i = old_nblocks; i < new_nblocks; ++i) {
+            init_block_(i);
+            if (i != old_nblocks)
+                prev_index_(i * __BLOCK_SIZE__) = i * __BLOCK_SIZE__ - 1;
+            if (i != new_nblocks - 1)
+                next_index_((i + 1) * __BLOCK_SIZE__ - 1) = (i + 1) * __BLOCK_SIZE__;
+        }
+
+        size_t last_new = new_nblocks * __BLOCK_SIZE__ - 1;
+        next_index_(last_new) = first_free_index_;
+        if (first_free_index_)
+            prev_index_(first_free_index_) = last_new;
+        first_free_index_ = old_nblocks * __BLOCK_SIZE__;
+    }
+
+
+    //gives all the nodes back to the free chain, blocks are kept. The chains are spliced in O(1), but
+    //invalidating the handles and emptying the bitmaps walks every block: O(capacity / 64 + size)
+    void clear() {
+        if (!size_)
+            return;
+
+        sweep_blocks_(0, buffer_ptr_->size(), [&](size_t index) { ++node_at_(index).generation; });
+
+        next_index_(*tail_index_) = first_free_index_;
+        if (first_free_index_)
+            prev_index_(first_free_index_) = *tail_index_;
+
+        first_free_index_ = *head_index_;
+        prev_index_(first_free_index_) = 0;
+
+        *head_index_ = *tail_index_ = 0;
+        size_ = 0;
+
+        occupied_.assign(occupied_.size(), Bitmap{});
+    }
+
+
     bool empty() const {
         return size_ == 0;
     }
 
 
 
+    using value_type = T;
     using iterator = ListIterator<T>;
     using const_iterator = ListIterator<const T>;
     using reverse_iterator = std::reverse_iterator<ListIterator<T>>;
@@ -507,19 +780,122 @@ public:
     }
 
 
+    template <typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+    iterator insert(iterator it, InputIt first, InputIt last) {
+        return iterator(buffer_ptr_, head_index_, tail_index_, insert_range_(it.index_, first, last));
+    }
+
+    template <typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+    iterator insert(const_iterator it, InputIt first, InputIt last) {
+        return iterator(buffer_ptr_, head_index_, tail_index_, insert_range_(it.index_, first, last));
+    }
+
+
+    template <typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+    void append_range(InputIt first, InputIt last) {
+        insert_range_(0, first, last);
+    }
+
+
+    template <typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+    void assign(InputIt first, InputIt last) {
+        clear();
+        insert_range_(0, first, last);
+    }
+
+
+    //relinks the node to the head in O(1), iterators and handles stay valid
+    void move_to_front(iterator it) {
+        unlink_(it.index_);
+        link_front_(it.index_);
+    }
+
+
+    ListHandle handle(iterator it) const {
+        return handle_(it.index_);
+    }
+
+    ListHandle handle(const_iterator it) const {
+        return handle_(it.index_);
+    }
+
+
+    //O(1): checks that the handle's node has not been removed (or moved by pull()) since handle() 
+    bool valid(ListHandle handle) const {
+        return handle.index && handle.index <= capacity() &&
+               (occupied_[handle.index / __BLOCK_SIZE__][handle.index % __BLOCK_SIZE__ / 64] >>
+                (handle.index % __BLOCK_SIZE__ % 64) & 1) &&
+               node_at_(handle.index).generation == handle.generation;
+    }
+
+
+    //nullptr if the handle is stale
+    T* get(ListHandle handle) {
+        return valid(handle) ? &data_(handle.index) : nullptr;
+    }
+
+    const T* get(ListHandle handle) const {
+        return valid(handle) ? &data_(handle.index) : nullptr;
+    }
+
+
+    //end() if the handle is stale
+    iterator to_iterator(ListHandle handle) {
+        return iterator(buffer_ptr_, head_index_, tail_index_, valid(handle) ? handle.index : 0);
+    }
+
+
     iterator remove(iterator it) {
         iterator next = ++it;
-        remove_((--it).index_);
+        erase_((--it).index_);
         return next;
     }
 
     iterator remove(const_iterator it) {
         iterator next = ++it;
-        remove_((--it).index_);
+        erase_((--it).index_);
         return next;
     }
 
 
+    //removes every element for which pred is true, pred is called in physical (not logical!) order;
+    //removed values are not copied or moved anywhere, returns the number of removed elements
+    template <typename Pred>
+    size_t remove_if(Pred pred) {
+        std::vector<Bitmap> doomed(occupied_.size());
+        size_t removed = 0;
+
+        sweep_blocks_(0, buffer_ptr_->size(), [&](size_t index) {
+            if (pred(data_(index))) {
+                word_(doomed, index) |= bit_(index);
+                ++removed;
+            }
+        });
+
+        if (!removed)
+            return 0;
+
+        for (size_t block = 0; block < doomed.size(); ++block)
+            for (size_t word = 0; word < doomed[block].size(); ++word)
+                occupied_[block][word] &= ~doomed[block][word];
+
+        erase_marked_(doomed);
+        return removed;
+    }
+
+
+    //removes [first, last) with one relink, returns last
+    iterator erase_range(iterator first, iterator last) {
+        erase_range_(first.index_, last.index_);
+        return last;
+    }
+
+    iterator erase_range(const_iterator first, const_iterator last) {
+        erase_range_(first.index_, last.index_);
+        return iterator(buffer_ptr_, head_index_, tail_index_, last.index_);
+    }
+
+
     void dump(FILE* file = nullptr) const {
         if (!file)
             file = fopen("list_dump", "w");
@@ -574,6 +950,11 @@ public:
         *tail_index_ = size();
         first_free_index_ = size() + 1;
 
+        //every slot changes its owner, so none of the handles given out before may resolve
+        for (size_t block = 0; block < buffer_ptr_->size(); ++block)
+            for (size_t j = 0; j < __BLOCK_SIZE__; ++j)
+                (*new_buffer_ptr)[block][j].generation = (*buffer_ptr_)[block][j].generation + 1;
+
         delete buffer_ptr_;
         buffer_ptr_ = new_buffer_ptr;
 
@@ -589,5 +970,66 @@ public:
         prev_index_(*head_index_) = 0;
         next_index_(*tail_index_) = 0;
         prev_index_(first_free_index_) = 0;
+
+        occupied_.assign(buffer_ptr_->size(), Bitmap{});
+        for (size_t index = 1; index <= size(); ++index)
+            occupy_(index);
+    }
+
+
+    //visits elements in physical (not logical!) order: blocks are swept sequentially, free nodes are skipped
+    template <typename F>
+    void for_each_unordered(F&& f) {
+        sweep_blocks_(0, buffer_ptr_->size(), [&](size_t index) { f(data_(index)); });
+    }
+
+    template <typename F>
+    void for_each_unordered(F&& f) const {
+        sweep_blocks_(0, buffer_ptr_->size(), [&](size_t index) { f(data_(index)); });
+    }
+
+
+    //same as for_each_unordered, but blocks are split into nthreads contiguous chunks, so f has to be safe
+    //to call concurrently on different elements. There is no pool: the calling thread sweeps the first
+    //chunk and a new std::thread is started (and joined) for each of the others on every call, so small
+    //lists are better left to for_each_unordered
+    template <typename F>
+    void parallel_for_each(F&& f, size_t nthreads = std::thread::hardware_concurrency()) {
+        size_t nblocks = buffer_ptr_->size();
+        nthreads = std::max<size_t>(1, std::min(nthreads, nblocks));
+
+        size_t chunk = (nblocks + nthreads - 1) / nthreads;
+        std::vector<std::exception_ptr> errors(nthreads);
+        auto worker = [&](size_t part) {
+            try {
+                size_t first_block = part * chunk;
+                sweep_blocks_(first_block, std::min(first_block + chunk, nblocks),
+                              [&](size_t index) { f(data_(index)); });
+            } catch (...) {
+                errors[part] = std::current_exception();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        auto join = [&] {
+            for (auto& thread : threads)
+                thread.join();
+        };
+
+        try {
+            for (size_t part = 1; part * chunk < nblocks; ++part)
+                threads.emplace_back(worker, part);
+        } catch (...) {
+            join();
+            throw;
+        }
+
+        worker(0);
+        join();
+
+        //the exception of the first chunk that threw, the others are dropped
+        for (auto& error : errors)
+            if (error)
+                std::rethrow_exception(error);
     }
 };
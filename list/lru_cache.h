@@ -0,0 +1,164 @@
+#pragma once
+
+#include "list.h"
+#include <vector>
+#include <functional>
+#include <cassert>
+#include <stdint.h>
+
+
+//Least-recently-used cache: entries live in a List (head - most recently used) that is reserved
+//once for the whole capacity, the index is an open-addressing (linear probing) table of 32-bit
+//slot indices of that List. get, put and touch are O(1) and never allocate.
+template <typename K, typename V, typename Hash = std::hash<K>>
+class LruCache {
+private:
+    struct Entry {
+        K key;
+        V value;
+    };
+
+    List<Entry> list_;
+    std::vector<uint32_t> table_;     // 0 - empty bucket (slot 0 of List is never used)
+    size_t capacity_;
+    size_t shift_;
+
+    size_t hits_;
+    size_t misses_;
+
+    std::function<void(const K&, V&)> on_evict_;
+
+
+    size_t bucket_(const K& key) const {
+        return (uint64_t)Hash()(key) * 0x9E3779B97F4A7C15ull >> shift_;
+    }
+
+    const K& key_at_(uint32_t slot) const {
+        return list_.data_(slot).key;
+    }
+
+    //bucket holding key or the empty bucket where key has to go
+    size_t find_(const K& key) const {
+        size_t mask = table_.size() - 1;
+        for (size_t bucket = bucket_(key); ; bucket = (bucket + 1) & mask)
+            if (!table_[bucket] || key_at_(table_[bucket]) == key)
+                return bucket;
+    }
+
+    //backward shift deletion: keeps probe chains unbroken without tombstones
+    void erase_bucket_(size_t hole) {
+        size_t mask = table_.size() - 1;
+        for (size_t bucket = (hole + 1) & mask; table_[bucket]; bucket = (bucket + 1) & mask) {
+            size_t ideal = bucket_(key_at_(table_[bucket]));
+            if (((bucket - ideal) & mask) >= ((bucket - hole) & mask)) {
+                table_[hole] = table_[bucket];
+                hole = bucket;
+            }
+        }
+        table_[hole] = 0;
+    }
+
+    void evict_() {
+        uint32_t slot = *list_.tail_index_;
+        Entry& entry = list_.data_(slot);
+
+        if (on_evict_)
+            on_evict_(entry.key, entry.value);
+
+        erase_bucket_(find_(entry.key));
+        list_.erase_(slot);
+    }
+
+
+public:
+    LruCache(size_t capacity, std::function<void(const K&, V&)> on_evict = nullptr)
+        : capacity_(capacity), shift_(64), hits_(0), misses_(0), on_evict_(on_evict) {
+            assert(capacity && capacity < UINT32_MAX / 2);
+
+            size_t nbuckets = 1;
+            while (nbuckets < 2 * capacity) {
+                nbuckets *= 2;
+                --shift_;
+            }
+
+            table_.assign(nbuckets, 0);
+            list_.reserve(capacity);
+        }
+
+
+    //marks key as the most recently used, nullptr if key is not cached
+    V* get(const K& key) {
+        uint32_t slot = table_[find_(key)];
+        if (!slot) {
+            ++misses_;
+            return nullptr;
+        }
+
+        ++hits_;
+        list_.unlink_(slot);
+        list_.link_front_(slot);
+        return &list_.data_(slot).value;
+    }
+
+
+    //inserts or updates key as the most recently used, evicts the least recently used if full
+    void put(const K& key, const V& value) {
+        size_t bucket = find_(key);
+        if (table_[bucket]) {
+            uint32_t slot = table_[bucket];
+            list_.data_(slot).value = value;
+            list_.unlink_(slot);
+            list_.link_front_(slot);
+            return;
+        }
+
+        if (list_.size() == capacity_) {
+            evict_();
+            bucket = find_(key);
+        }
+
+        list_.push_front(Entry{key, value});
+        table_[bucket] = *list_.head_index_;
+    }
+
+
+    //like get, but does not count as a hit or a miss
+    bool touch(const K& key) {
+        uint32_t slot = table_[find_(key)];
+        if (!slot)
+            return false;
+
+        list_.unlink_(slot);
+        list_.link_front_(slot);
+        return true;
+    }
+
+
+    bool erase(const K& key) {
+        size_t bucket = find_(key);
+        uint32_t slot = table_[bucket];
+        if (!slot)
+            return false;
+
+        erase_bucket_(bucket);
+        list_.erase_(slot);
+        return true;
+    }
+
+
+    size_t size() const {
+        return list_.size();
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    size_t hits() const {
+        return hits_;
+    }
+
+    size_t misses() const {
+        return misses_;
+    }
+};
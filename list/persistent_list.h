@@ -0,0 +1,394 @@
+#pragma once
+
+#include <iterator>
+#include <cassert>
+#include <string>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+//List whose blocks live in an mmap'd file. Nodes are linked by indices only,
+//so the mapping is position independent and opening a list of any size costs one mmap.
+//Changes reach the file through the page cache; sync() makes them durable.
+template <typename T>
+class PersistentList {
+    static_assert(std::is_trivially_copyable<T>::value, "PersistentList needs trivially copyable T");
+
+private:
+    struct Node {
+        uint64_t next, prev;
+        T data;
+    };
+
+    struct Header {
+        char signature[8];
+        uint32_t version;
+        uint32_t block_size;
+        uint64_t element_size;
+        uint64_t node_size;
+        uint64_t nblocks;
+        uint64_t size;
+        uint64_t head_index;
+        uint64_t tail_index;
+        uint64_t first_free_index;
+    };
+
+    constexpr static const char* __SIGNATURE__ = "DKLIST";
+    const static uint32_t __FORMAT_VERSION__ = 1;
+    const static size_t __BLOCK_SIZE__ = 100;
+    const static size_t __DATA_OFFSET__ = (sizeof(Header) + 63) / 64 * 64;
+
+    std::string filename_;
+    int fd_;
+    char* base_;
+    size_t mapped_size_;
+
+
+    [[noreturn]] void panic_() const {
+        const int saved_errno = errno;
+        throw std::system_error(saved_errno, std::generic_category(), filename_);
+    }
+
+    [[noreturn]] void corrupted_(const char* what) const {
+        throw std::runtime_error(filename_ + ": " + what);
+    }
+
+
+    static size_t file_size_(uint64_t nblocks) {
+        return __DATA_OFFSET__ + nblocks * __BLOCK_SIZE__ * sizeof(Node);
+    }
+
+    Header& header_() const {
+        return *(Header*)base_;
+    }
+
+    Node& node_at_(uint64_t index) const {
+        return ((Node*)(base_ + __DATA_OFFSET__))[index];
+    }
+
+
+    void init_block_(uint64_t block_index) {
+        uint64_t i0 = block_index * __BLOCK_SIZE__;
+        for (uint64_t i = 0; i < __BLOCK_SIZE__; ++i) {
+            node_at_(i0 + i).next = i0 + i + 1;
+            node_at_(i0 + i).prev = i0 + i - 1;
+        }
+        node_at_(i0).prev = 0;
+        node_at_(i0 + __BLOCK_SIZE__ - 1).next = 0;
+    }
+
+
+    void map_(size_t size) {
+        if (ftruncate(fd_, size) == -1)
+            panic_();
+
+        void* base = base_ ? mremap(base_, mapped_size_, size, MREMAP_MAYMOVE)
+                           : mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (base == MAP_FAILED)
+            panic_();
+
+        base_ = (char*)base;
+        mapped_size_ = size;
+    }
+
+
+    void create_() {
+        map_(file_size_(1));
+
+        Header& header = header_();
+        memset(&header, 0, sizeof(Header));
+        strncpy(header.signature, __SIGNATURE__, sizeof(header.signature));
+        header.version = __FORMAT_VERSION__;
+        header.block_size = __BLOCK_SIZE__;
+        header.element_size = sizeof(T);
+        header.node_size = sizeof(Node);
+        header.nblocks = 1;
+        header.first_free_index = 1;
+
+        init_block_(0);
+        node_at_(0).next = 0;
+    }
+
+
+    void validate_(size_t size) const {
+        const Header& header = header_();
+        uint64_t capacity = header.nblocks * __BLOCK_SIZE__;
+
+        if (strncmp(header.signature, __SIGNATURE__, sizeof(header.signature)))
+            corrupted_("wrong signature");
+        if (header.version != __FORMAT_VERSION__)
+            corrupted_("unsupported version");
+        if (header.block_size != __BLOCK_SIZE__)
+            corrupted_("block size mismatch");
+        if (header.element_size != sizeof(T) || header.node_size != sizeof(Node))
+            corrupted_("element type size mismatch");
+        if (!header.nblocks || size != file_size_(header.nblocks))
+            corrupted_("file size does not match the number of blocks");
+        if (header.size >= capacity || header.head_index >= capacity ||
+            header.tail_index >= capacity || header.first_free_index >= capacity)
+                corrupted_("index out of range");
+    }
+
+
+    void expand_if_necessary_() {
+        Header& header = header_();
+        if (header.first_free_index)
+            return;
+
+        uint64_t block_index = header.nblocks;
+        map_(file_size_(block_index + 1));
+
+        header_().nblocks = block_index + 1;
+        init_block_(block_index);
+        header_().first_free_index = block_index * __BLOCK_SIZE__;
+    }
+
+
+    //takes a node from the free chain and stores item there
+    uint64_t allocate_(const T& item) {
+        expand_if_necessary_();
+
+        Header& header = header_();
+        uint64_t index = header.first_free_index;
+
+        header.first_free_index = node_at_(index).next;
+        node_at_(header.first_free_index).prev = 0;
+        node_at_(index).data = item;
+        ++header.size;
+
+        return index;
+    }
+
+
+    void insert_(uint64_t before_which_index, const T& item) {
+        uint64_t index = allocate_(item);
+        Header& header = header_();
+
+        uint64_t prev = before_which_index ? node_at_(before_which_index).prev : header.tail_index;
+
+        node_at_(index).next = before_which_index;
+        node_at_(index).prev = prev;
+
+        if (prev)
+            node_at_(prev).next = index;
+        else
+            header.head_index = index;
+
+        if (before_which_index)
+            node_at_(before_which_index).prev = index;
+        else
+            header.tail_index = index;
+    }
+
+
+    void remove_(uint64_t index) {
+        Header& header = header_();
+        Node& node = node_at_(index);
+
+        if (node.prev)
+            node_at_(node.prev).next = node.next;
+        else
+            header.head_index = node.next;
+
+        if (node.next)
+            node_at_(node.next).prev = node.prev;
+        else
+            header.tail_index = node.prev;
+
+        node.next = header.first_free_index;
+        node.prev = 0;
+        node_at_(header.first_free_index).prev = index;
+        header.first_free_index = index;
+
+        --header.size;
+    }
+
+
+    template <typename ValueType>
+    class PersistentListIterator : public std::iterator<std::bidirectional_iterator_tag,
+                                                        T,
+                                                        std::ptrdiff_t,
+                                                        ValueType*,
+                                                        ValueType&> {
+        friend class PersistentList;
+    private:
+        const PersistentList* list_;
+        uint64_t index_;
+
+    public:
+        PersistentListIterator(const PersistentList* list, uint64_t index)
+            : list_(list), index_(index) {}
+
+        PersistentListIterator()
+            : list_(nullptr), index_(0) {}
+
+
+        bool operator==(const PersistentListIterator& another) const {
+            return list_ == another.list_ && index_ == another.index_;
+        }
+
+        bool operator!=(const PersistentListIterator& another) const {
+            return !(*this == another);
+        }
+
+
+        PersistentListIterator& operator++() {
+            index_ = index_ ? list_->node_at_(index_).next : list_->header_().head_index;
+            return *this;
+        }
+
+        PersistentListIterator& operator--() {
+            index_ = index_ ? list_->node_at_(index_).prev : list_->header_().tail_index;
+            return *this;
+        }
+
+
+        ValueType* operator->() const {
+            return &list_->node_at_(index_).data;
+        }
+
+        ValueType& operator*() const {
+            return list_->node_at_(index_).data;
+        }
+    };
+
+
+public:
+    //opens the list stored in filename, an empty or missing file becomes an empty list
+    explicit PersistentList(const char* filename)
+        : filename_(filename), fd_(open(filename, O_RDWR | O_CREAT, 0644)),
+          base_(nullptr), mapped_size_(0) {
+            if (fd_ == -1)
+                panic_();
+
+            struct stat s = {};
+            if (fstat(fd_, &s) == -1) {
+                close(fd_);
+                panic_();
+            }
+
+            try {
+                if (!s.st_size)
+                    create_();
+                else if ((size_t)s.st_size < __DATA_OFFSET__)
+                    corrupted_("file is too short");
+                else {
+                    map_(s.st_size);
+                    validate_(s.st_size);
+                }
+            } catch (...) {
+                if (base_)
+                    munmap(base_, mapped_size_);
+                close(fd_);
+                throw;
+            }
+        }
+
+
+    ~PersistentList() {
+        munmap(base_, mapped_size_);
+        close(fd_);
+    }
+
+
+    PersistentList(const PersistentList&) = delete;
+    PersistentList& operator=(const PersistentList&) = delete;
+
+
+    //flushes the mapping to the file
+    void sync() {
+        if (msync(base_, mapped_size_, MS_SYNC) == -1)
+            panic_();
+    }
+
+
+    size_t size() const {
+        return header_().size;
+    }
+
+    bool empty() const {
+        return !size();
+    }
+
+
+    void push_back(const T& item) {
+        insert_(0, item);
+    }
+
+    void push_front(const T& item) {
+        insert_(header_().head_index, item);
+    }
+
+    void pop_back() {
+        assert(size());
+        remove_(header_().tail_index);
+    }
+
+    void pop_front() {
+        assert(size());
+        remove_(header_().head_index);
+    }
+
+
+    T& back() {
+        assert(size());
+        return node_at_(header_().tail_index).data;
+    }
+
+    const T& back() const {
+        assert(size());
+        return node_at_(header_().tail_index).data;
+    }
+
+    T& front() {
+        assert(size());
+        return node_at_(header_().head_index).data;
+    }
+
+    const T& front() const {
+        assert(size());
+        return node_at_(header_().head_index).data;
+    }
+
+
+    using iterator = PersistentListIterator<T>;
+    using const_iterator = PersistentListIterator<const T>;
+
+
+    iterator begin() {
+        return iterator(this, header_().head_index);
+    }
+
+    iterator end() {
+        return iterator(this, 0);
+    }
+
+    const_iterator cbegin() const {
+        return const_iterator(this, header_().head_index);
+    }
+
+    const_iterator cend() const {
+        return const_iterator(this, 0);
+    }
+
+
+    iterator insert(iterator it, const T& item) {
+        insert_(it.index_, item);
+        return --it;
+    }
+
+    iterator remove(iterator it) {
+        iterator next = it;
+        ++next;
+        remove_(it.index_);
+        return next;
+    }
+};
@@ -0,0 +1,78 @@
+#include "list.h"
+#include "concurrent_queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// the way the queue used to be shared: one List under one global mutex
+class LockedList {
+private:
+    List<long long> list_;
+    std::mutex mutex_;
+
+public:
+    void push_back(const long long& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        list_.push_back(item);
+    }
+
+    bool pop_front(long long& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (list_.empty())
+            return false;
+        item = list_.front();
+        list_.pop_front();
+        return true;
+    }
+};
+
+
+// nthreads producers and nthreads consumers move nitems items in total, returns items per second
+template <typename Queue>
+double run(size_t nthreads, size_t nitems) {
+    Queue queue;
+    std::atomic<size_t> popped(0);
+    std::atomic<bool> start(false);
+
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < nthreads; ++p)
+        threads.emplace_back([&, p] {
+            while (!start);
+            for (size_t i = p; i < nitems; i += nthreads)
+                queue.push_back(i);
+        });
+
+    for (size_t c = 0; c < nthreads; ++c)
+        threads.emplace_back([&] {
+            while (!start);
+            long long item = 0;
+            while (popped.load(std::memory_order_relaxed) < nitems)
+                if (queue.pop_front(item))
+                    popped.fetch_add(1, std::memory_order_relaxed);
+        });
+
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+    for (auto& thread : threads)
+        thread.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    return nitems / elapsed.count();
+}
+
+
+int main(int argc, char** argv) {
+    size_t max_threads = argc > 1 ? atoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+    size_t nitems = argc > 2 ? atoi(argv[2]) : 2000000;
+
+    printf("%8s %20s %20s\n", "threads", "ConcurrentQueue", "mutex + List");
+    for (size_t nthreads = 1; nthreads <= max_threads; ++nthreads)
+        printf("%8zu %16.2f M/s %16.2f M/s\n", nthreads,
+               run<ConcurrentQueue<long long>>(nthreads, nitems) / 1e6,
+               run<LockedList>(nthreads, nitems) / 1e6);
+}
@@ -0,0 +1,387 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <cassert>
+#include <stdint.h>
+
+
+//List for one writer and many concurrent readers. A reader takes a snapshot and iterates
+//the list exactly as it was at that moment while the writer keeps inserting and removing.
+//
+//Every node carries the epochs of its insertion (birth) and removal (death); a snapshot of epoch e
+//sees the nodes with birth <= e < death. A removed node stays linked until no snapshot older than its
+//death is alive, then it is unlinked, and its slot is reused only once every reader that could have
+//been standing on it has finished. Blocks are never moved, so an index stays dereferenceable forever.
+//
+//Each alive snapshot holds one of __MAX_READERS__ (64) reader slots, snapshot() throws std::length_error
+//when all of them are taken. Inserting throws std::length_error when all __MAX_BLOCKS__ blocks are in use.
+template <typename T>
+class SnapshotList {
+private:
+    struct Node {
+        std::atomic<uint64_t> next;
+        uint64_t prev;                       // used by the writer only
+        std::atomic<uint64_t> birth;
+        std::atomic<uint64_t> death;
+        T data;
+    };
+
+    const static size_t __BLOCK_SIZE__ = 128;
+    const static size_t __MAX_BLOCKS__ = 1 << 16;
+    const static size_t __MAX_READERS__ = 64;
+    const static size_t __RECLAIM_THRESHOLD__ = 64;
+
+    const static uint64_t __ALIVE__ = UINT64_MAX;
+    const static uint64_t __NO_READER__ = UINT64_MAX;
+
+    using Block = std::array<Node, __BLOCK_SIZE__>;
+
+    std::atomic<Block*>* blocks_;
+    mutable std::atomic<uint64_t> readers_[__MAX_READERS__];
+    std::atomic<uint64_t> epoch_;
+
+    // the writer's state
+    size_t nblocks_;
+    size_t size_;
+    uint64_t tail_index_;                    // physical tail, may be a removed node
+    uint64_t first_free_index_;
+    std::vector<std::pair<uint64_t, uint64_t>> removed_;    // still linked: (index, death)
+    std::vector<std::pair<uint64_t, uint64_t>> unlinked_;   // waiting for readers: (index, unlink epoch)
+
+
+    Node& node_at_(uint64_t index) const {
+        return (*blocks_[index / __BLOCK_SIZE__].load(std::memory_order_acquire))[index % __BLOCK_SIZE__];
+    }
+
+
+    bool visible_(uint64_t index, uint64_t epoch) const {
+        const Node& node = node_at_(index);
+        return node.birth.load(std::memory_order_acquire) <= epoch &&
+               epoch < node.death.load(std::memory_order_acquire);
+    }
+
+    bool alive_(uint64_t index) const {
+        return node_at_(index).death.load(std::memory_order_relaxed) == __ALIVE__;
+    }
+
+    uint64_t next_visible_(uint64_t index, uint64_t epoch) const {
+        do
+            index = node_at_(index).next.load(std::memory_order_acquire);
+        while (index && !visible_(index, epoch));
+        return index;
+    }
+
+    uint64_t next_alive_(uint64_t index) const {
+        do
+            index = node_at_(index).next.load(std::memory_order_relaxed);
+        while (index && !alive_(index));
+        return index;
+    }
+
+
+    //epoch of the oldest registered snapshot, or the current epoch + 1 if there are none
+    uint64_t oldest_reader_() const {
+        uint64_t oldest = epoch_.load() + 1;
+        for (size_t i = 0; i < __MAX_READERS__; ++i)
+            oldest = std::min(oldest, readers_[i].load());
+        return oldest;
+    }
+
+
+    void expand_if_necessary_() {
+        if (first_free_index_)
+            return;
+
+        reclaim();
+        if (first_free_index_)
+            return;
+
+        if (nblocks_ == __MAX_BLOCKS__)
+            throw std::length_error("SnapshotList is full");
+
+        Block* block = new Block();
+        uint64_t i0 = nblocks_ * __BLOCK_SIZE__;
+        for (uint64_t i = 0; i < __BLOCK_SIZE__; ++i)
+            (*block)[i].next.store(i + 1 < __BLOCK_SIZE__ ? i0 + i + 1 : 0, std::memory_order_relaxed);
+
+        blocks_[nblocks_].store(block, std::memory_order_release);
+        first_free_index_ = nblocks_ ? i0 : 1;
+        ++nblocks_;
+    }
+
+
+    //links a new node after the node after_which_index (0 - the head sentinel)
+    void insert_after_(uint64_t after_which_index, const T& item) {
+        expand_if_necessary_();
+
+        uint64_t index = first_free_index_;
+        Node& node = node_at_(index);
+        first_free_index_ = node.next.load(std::memory_order_relaxed);
+
+        uint64_t epoch = epoch_.load(std::memory_order_relaxed) + 1;
+        uint64_t next = node_at_(after_which_index).next.load(std::memory_order_relaxed);
+
+        node.data = item;
+        node.birth.store(epoch, std::memory_order_relaxed);
+        node.death.store(__ALIVE__, std::memory_order_relaxed);
+        node.prev = after_which_index;
+        node.next.store(next, std::memory_order_relaxed);
+
+        if (next)
+            node_at_(next).prev = index;
+        else
+            tail_index_ = index;
+
+        node_at_(after_which_index).next.store(index, std::memory_order_release);
+        epoch_.store(epoch);
+
+        ++size_;
+    }
+
+
+    template <bool is_snapshot>
+    class SnapshotListIterator : public std::iterator<std::forward_iterator_tag,
+                                                      T,
+                                                      std::ptrdiff_t,
+                                                      const T*,
+                                                      const T&> {
+        friend class SnapshotList;
+    private:
+        const SnapshotList* list_;
+        uint64_t epoch_;
+        uint64_t index_;
+
+    public:
+        SnapshotListIterator(const SnapshotList* list, uint64_t epoch, uint64_t index)
+            : list_(list), epoch_(epoch), index_(index) {}
+
+        SnapshotListIterator()
+            : list_(nullptr), epoch_(0), index_(0) {}
+
+
+        bool operator==(const SnapshotListIterator& another) const {
+            return list_ == another.list_ && index_ == another.index_;
+        }
+
+        bool operator!=(const SnapshotListIterator& another) const {
+            return !(*this == another);
+        }
+
+
+        SnapshotListIterator& operator++() {
+            index_ = is_snapshot ? list_->next_visible_(index_, epoch_) : list_->next_alive_(index_);
+            return *this;
+        }
+
+
+        const T* operator->() const {
+            return &list_->node_at_(index_).data;
+        }
+
+        const T& operator*() const {
+            return list_->node_at_(index_).data;
+        }
+    };
+
+
+public:
+    using iterator = SnapshotListIterator<false>;
+    using snapshot_iterator = SnapshotListIterator<true>;
+
+
+    //the list as of the moment it was taken; keeps removed nodes from being reclaimed while alive
+    class Snapshot {
+        friend class SnapshotList;
+    private:
+        const SnapshotList* list_;
+        size_t slot_;
+        uint64_t epoch_;
+
+        Snapshot(const SnapshotList* list, size_t slot, uint64_t epoch)
+            : list_(list), slot_(slot), epoch_(epoch) {}
+
+    public:
+        Snapshot(Snapshot&& another)
+            : list_(another.list_), slot_(another.slot_), epoch_(another.epoch_) {
+                another.list_ = nullptr;
+            }
+
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        Snapshot& operator=(Snapshot&&) = delete;
+
+        ~Snapshot() {
+            if (list_)
+                list_->readers_[slot_].store(__NO_READER__);
+        }
+
+
+        uint64_t epoch() const {
+            return epoch_;
+        }
+
+        snapshot_iterator begin() const {
+            return snapshot_iterator(list_, epoch_, list_->next_visible_(0, epoch_));
+        }
+
+        snapshot_iterator end() const {
+            return snapshot_iterator(list_, epoch_, 0);
+        }
+    };
+
+
+    SnapshotList()
+        : blocks_(new std::atomic<Block*>[__MAX_BLOCKS__]()), epoch_(1),
+          nblocks_(0), size_(0), tail_index_(0), first_free_index_(0) {
+            for (size_t i = 0; i < __MAX_READERS__; ++i)
+                readers_[i].store(__NO_READER__);
+
+            expand_if_necessary_();
+            node_at_(0).next.store(0);
+        }
+
+
+    ~SnapshotList() {
+        for (size_t i = 0; i < nblocks_; ++i)
+            delete blocks_[i].load();
+        delete[] blocks_;
+    }
+
+
+    SnapshotList(const SnapshotList&) = delete;
+    SnapshotList& operator=(const SnapshotList&) = delete;
+
+
+    //may be called from any thread, throws std::length_error if __MAX_READERS__ snapshots are alive
+    Snapshot snapshot() const {
+        size_t slot = 0;
+        while (true) {
+            uint64_t expected = __NO_READER__;
+            // 0 is older than any epoch, so the writer keeps everything until the real epoch is published
+            if (readers_[slot].compare_exchange_strong(expected, 0))
+                break;
+            if (++slot == __MAX_READERS__)
+                throw std::length_error("SnapshotList has no free reader slot");
+        }
+
+        uint64_t epoch = epoch_.load();
+        while (true) {
+            readers_[slot].store(epoch);
+            uint64_t current = epoch_.load();
+            if (current == epoch)
+                break;
+            epoch = current;
+        }
+
+        return Snapshot(this, slot, epoch);
+    }
+
+
+    // the rest is for the writer only
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return !size_;
+    }
+
+
+    iterator begin() const {
+        return iterator(this, 0, next_alive_(0));
+    }
+
+    iterator end() const {
+        return iterator(this, 0, 0);
+    }
+
+
+    void push_back(const T& item) {
+        insert_after_(tail_index_, item);
+    }
+
+    void push_front(const T& item) {
+        insert_after_(0, item);
+    }
+
+
+    //removes the element for the snapshots taken from now on, returns the next element
+    iterator remove(iterator it) {
+        uint64_t epoch = epoch_.load(std::memory_order_relaxed) + 1;
+        node_at_(it.index_).death.store(epoch, std::memory_order_release);
+        epoch_.store(epoch);
+
+        removed_.emplace_back(it.index_, epoch);
+        --size_;
+
+        iterator next = it;
+        ++next;
+
+        if (removed_.size() + unlinked_.size() >= __RECLAIM_THRESHOLD__)
+            reclaim();
+
+        return next;
+    }
+
+    void pop_front() {
+        assert(size_);
+        remove(begin());
+    }
+
+
+    //unlinks the removed nodes no snapshot can see any more and frees the slots no reader can stand on
+    void reclaim() {
+        uint64_t oldest = oldest_reader_();
+
+        size_t still_removed = 0;
+        bool unlinked_any = false;
+        for (auto& item : removed_) {
+            if (item.second > oldest) {
+                removed_[still_removed++] = item;
+                continue;
+            }
+
+            Node& node = node_at_(item.first);
+            uint64_t next = node.next.load(std::memory_order_relaxed);
+            if (next)
+                node_at_(next).prev = node.prev;
+            else
+                tail_index_ = node.prev;
+            node_at_(node.prev).next.store(next, std::memory_order_release);
+
+            unlinked_.emplace_back(item.first, 0);
+            unlinked_any = true;
+        }
+        removed_.resize(still_removed);
+
+        // the readers that have seen this epoch can't reach the nodes unlinked above
+        if (unlinked_any) {
+            uint64_t epoch = epoch_.load(std::memory_order_relaxed) + 1;
+            epoch_.store(epoch);
+            for (auto& item : unlinked_)
+                if (!item.second)
+                    item.second = epoch;
+        }
+
+        oldest = oldest_reader_();
+
+        size_t still_unlinked = 0;
+        for (auto& item : unlinked_) {
+            if (item.second > oldest) {
+                unlinked_[still_unlinked++] = item;
+                continue;
+            }
+
+            node_at_(item.first).next.store(first_free_index_, std::memory_order_relaxed);
+            first_free_index_ = item.first;
+        }
+        unlinked_.resize(still_unlinked);
+    }
+};
@@ -1,6 +1,16 @@
 #include "list.h"
+#include "concurrent_queue.h"
+#include "persistent_list.h"
+#include "lru_cache.h"
+#include "snapshot_list.h"
 #include <iostream>
 #include <string>
+#include <atomic>
+#include <vector>
+#include <sstream>
+#include <unordered_map>
+#include <list>
+#include <random>
 
 
 void push_pop_test() {
@@ -221,6 +231,422 @@ void dump_test() {
 }
 
 
+void unordered_traversal_test() {
+    List<int> list;
+    long long sum = 0;
+    for (int i = 0; i < 1050; ++i) {
+        list.push_back(i);
+        list.push_front(-2 * i);
+        sum += i - 2 * i;
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        sum -= list.back() + list.front();
+        list.pop_back();
+        list.pop_front();
+    }
+
+    long long unordered_sum = 0;
+    size_t visited = 0;
+    list.for_each_unordered([&](int x) { unordered_sum += x; ++visited; });
+    assert(unordered_sum == sum && visited == list.size());
+
+    std::atomic<long long> parallel_sum(0);
+    std::atomic<size_t> parallel_visited(0);
+    list.parallel_for_each([&](int& x) { parallel_sum += x; ++parallel_visited; x = 1; }, 4);
+    assert(parallel_sum == sum && parallel_visited == list.size());
+
+    // an exception of any thread comes out of parallel_for_each after all of them have finished
+    const std::thread::id caller = std::this_thread::get_id();
+    for (int on_caller = 0; on_caller < 2; ++on_caller) {
+        bool thrown = false;
+        try {
+            list.parallel_for_each([&](int&) {
+                if ((std::this_thread::get_id() == caller) == (bool)on_caller)
+                    throw std::runtime_error("parallel_for_each_test");
+            }, 4);
+        } catch (std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+
+    list.pull();
+    long long ones = 0;
+    list.for_each_unordered([&](int x) { ones += x; });
+    assert(ones == (long long)list.size());
+}
+
+
+void reserve_range_test() {
+    List<int> list;
+    list.reserve(100000);
+    size_t capacity = list.capacity();
+    assert(capacity >= 100000);
+
+    for (int i = 0; i < 100000; ++i)
+        list.push_back(i);
+    assert(list.capacity() == capacity);
+
+    std::vector<int> v = {-1, -2, -3};
+    List<int>::iterator it = list.begin();
+    ++it; ++it;
+    it = list.insert(it, v.begin(), v.end());
+    assert(*it == -1 && list.size() == 100003);
+
+    list.insert(list.end(), 7);
+    assert(list.back() == 7 && list.size() == 100004);
+
+    std::istringstream in("10 20 30");
+    list.assign(std::istream_iterator<int>(in), std::istream_iterator<int>());
+    list.append_range(v.begin(), v.end());
+    list.append_range(v.begin(), v.begin());
+
+    int a[] = {10, 20, 30, -1, -2, -3};
+    assert(list.size() == 6);
+
+    int j = 0;
+    for (List<int>::iterator i = list.begin(); i != list.end(); ++i, ++j)
+        assert(*i == a[j]);
+
+    list.clear();
+    assert(list.empty() && list.begin() == list.end());
+    list.push_front(1);
+    assert(list.front() == 1 && list.back() == 1);
+}
+
+
+void handles_test() {
+    List<int> list;
+    std::unordered_map<ListHandle, int> cache;
+
+    for (int i = 0; i < 300; ++i) {
+        list.push_back(i);
+        cache[list.handle(--list.end())] = i;
+    }
+
+    for (auto& item : cache)
+        assert(list.valid(item.first) && *list.get(item.first) == item.second);
+
+    List<int>::iterator it = list.begin();
+    ++it;
+    ListHandle removed = list.handle(it);
+    ListHandle kept = list.handle(++list.begin());
+    assert(removed == kept);
+
+    list.remove(it);
+    assert(!list.valid(removed) && !list.get(removed));
+    assert(list.to_iterator(removed) == list.end());
+
+    list.push_back(1000);
+    assert(!list.valid(removed));
+    assert(*list.get(list.handle(--list.end())) == 1000);
+
+    ListHandle front = list.handle(list.begin());
+    assert(*list.to_iterator(front) == 0);
+
+    list.pull();
+    assert(!list.valid(front));
+
+    ListHandle back = list.handle(--list.end());
+    list.clear();
+    assert(!list.valid(back) && !list.valid(ListHandle()));
+}
+
+
+void concurrent_queue_test() {
+    ConcurrentQueue<long long> queue;
+    long long item = 0;
+    assert(queue.empty() && !queue.pop_front(item));
+
+    const int nproducers = 4, nconsumers = 4, nitems = 50000;
+    std::atomic<long long> sum(0);
+    std::atomic<int> popped(0);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < nproducers; ++p)
+        threads.emplace_back([&, p] {
+            for (int i = 1; i <= nitems; ++i)
+                queue.push_back(p * nitems + i);
+        });
+
+    for (int c = 0; c < nconsumers; ++c)
+        threads.emplace_back([&] {
+            long long last[nproducers] = {};
+            long long value = 0;
+            while (popped < nproducers * nitems)
+                if (queue.pop_front(value)) {
+                    // items of one producer come out in order
+                    int p = (value - 1) / nitems;
+                    assert(last[p] < value);
+                    last[p] = value;
+
+                    sum += value;
+                    ++popped;
+                }
+        });
+
+    for (auto& thread : threads)
+        thread.join();
+
+    long long n = (long long)nproducers * nitems;
+    assert(sum == n * (n + 1) / 2 && queue.empty());
+}
+
+
+struct Point {
+    int a;
+    long long b;
+};
+
+
+void persistent_list_test() {
+    const char* filename = "persistent_list_test";
+    remove(filename);
+
+    {
+        PersistentList<Point> list(filename);
+        assert(list.empty());
+
+        for (int i = 0; i < 1050; ++i) {
+            list.push_back({i, 2 * i});
+            list.push_front({-i, -2 * i});
+        }
+        for (int i = 0; i < 50; ++i) {
+            list.pop_back();
+            list.pop_front();
+        }
+
+        auto it = list.begin();
+        ++it;
+        list.remove(list.insert(it, {100500, 0}));
+        list.insert(it, {7, 7});
+        list.sync();
+    }
+
+    {
+        PersistentList<Point> list(filename);
+        assert(list.size() == 2001);
+        assert(list.front().a == -999 && list.back().a == 999);
+
+        auto it = list.begin();
+        ++it;
+        assert(it->a == 7 && (++it)->a == -998);
+
+        long long sum = 0;
+        for (auto i = list.cbegin(); i != list.cend(); ++i)
+            sum += i->b;
+        assert(sum == 7);
+    }
+
+    try {
+        PersistentList<long long> list(filename);
+        assert(false);
+    } catch (std::runtime_error&) {}
+
+    remove(filename);
+}
+
+
+void lru_cache_test() {
+    {
+        std::vector<int> evicted;
+        LruCache<int, std::string> cache(3, [&](const int& key, std::string&) { evicted.push_back(key); });
+
+        cache.put(1, "one");
+        cache.put(2, "two");
+        cache.put(3, "three");
+        assert(*cache.get(1) == "one");
+
+        cache.put(4, "four");
+        assert(evicted.size() == 1 && evicted[0] == 2);
+        assert(!cache.get(2) && cache.size() == 3);
+
+        assert(cache.touch(3));
+        cache.put(5, "five");
+        assert(evicted.back() == 1);
+
+        cache.put(3, "THREE");
+        assert(*cache.get(3) == "THREE");
+        assert(cache.erase(3) && !cache.erase(3) && cache.size() == 2);
+        assert(cache.hits() == 2 && cache.misses() == 1);
+    }
+
+    {
+        // against std::list + std::unordered_map
+        const size_t capacity = 500;
+        LruCache<int, int> cache(capacity);
+        std::list<std::pair<int, int>> order;
+        std::unordered_map<int, std::list<std::pair<int, int>>::iterator> index;
+
+        std::mt19937 gen(24);
+        for (int i = 0; i < 200000; ++i) {
+            int key = gen() % 2000;
+            if (gen() % 2) {
+                int* value = cache.get(key);
+                auto it = index.find(key);
+                assert((value != nullptr) == (it != index.end()));
+                if (value) {
+                    assert(*value == it->second->second);
+                    order.splice(order.begin(), order, it->second);
+                }
+            }
+            else if (gen() % 8) {
+                cache.put(key, i);
+                auto it = index.find(key);
+                if (it != index.end()) {
+                    it->second->second = i;
+                    order.splice(order.begin(), order, it->second);
+                }
+                else {
+                    if (order.size() == capacity) {
+                        index.erase(order.back().first);
+                        order.pop_back();
+                    }
+                    order.emplace_front(key, i);
+                    index[key] = order.begin();
+                }
+            }
+            else {
+                auto it = index.find(key);
+                assert(cache.erase(key) == (it != index.end()));
+                if (it != index.end()) {
+                    order.erase(it->second);
+                    index.erase(it);
+                }
+            }
+            assert(cache.size() == order.size());
+        }
+    }
+}
+
+void snapshot_list_test() {
+    {
+        SnapshotList<int> list;
+        for (int i = 0; i < 10; ++i)
+            list.push_back(i);
+
+        auto snapshot = list.snapshot();
+        list.pop_front();
+        list.push_front(-1);
+        list.push_back(10);
+        for (auto it = list.begin(); it != list.end(); )
+            it = *it % 2 ? list.remove(it) : ++it;
+        list.reclaim();
+
+        std::vector<int> seen(snapshot.begin(), snapshot.end());
+        assert(seen == std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+
+        std::vector<int> current(list.begin(), list.end());
+        assert(current == std::vector<int>({2, 4, 6, 8, 10}) && list.size() == 5);
+    }
+
+    {
+        // 64 snapshots at most, a slot is free again once its snapshot is gone
+        SnapshotList<int> list;
+        std::vector<SnapshotList<int>::Snapshot> snapshots;
+        snapshots.reserve(64);
+        for (int i = 0; i < 64; ++i)
+            snapshots.push_back(list.snapshot());
+
+        bool thrown = false;
+        try {
+            list.snapshot();
+        } catch (std::length_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        snapshots.pop_back();
+        auto snapshot = list.snapshot();
+        assert(snapshot.begin() == snapshot.end());
+    }
+
+    // the writer appends increasing numbers and removes from the front,
+    // so every snapshot must be a contiguous increasing run that does not change while it is read
+    SnapshotList<long long> list;
+    std::atomic<bool> done(false);
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r)
+        readers.emplace_back([&] {
+            while (!done) {
+                auto snapshot = list.snapshot();
+                std::vector<long long> first(snapshot.begin(), snapshot.end());
+                std::vector<long long> second(snapshot.begin(), snapshot.end());
+                assert(first == second);
+                for (size_t i = 1; i < first.size(); ++i)
+                    assert(first[i] == first[i - 1] + 1);
+            }
+        });
+
+    for (long long i = 0; i < 50000; ++i) {
+        list.push_back(i);
+        if (list.size() > 1000)
+            list.pop_front();
+    }
+    done = true;
+
+    for (auto& thread : readers)
+        thread.join();
+
+    list.reclaim();
+    assert(list.size() == 1000 && *list.begin() == 49000);
+}
+
+void bulk_remove_test() {
+    List<int> list;
+    std::list<int> expected;
+    std::mt19937 gen(24);
+    for (int i = 0; i < 1000; ++i) {
+        auto it = list.begin();
+        auto expected_it = expected.begin();
+        for (size_t steps = gen() % 8; steps && it != list.end(); --steps, ++it, ++expected_it);
+        list.insert(it, i);
+        expected.insert(expected_it, i);
+    }
+
+    ListHandle front = list.handle(list.begin());
+    bool front_survives = list.front() % 3 != 0;
+
+    assert(list.remove_if([](int x) { return x % 3 == 0; }) == 334);
+    expected.remove_if([](int x) { return x % 3 == 0; });
+    assert(list.size() == expected.size());
+    assert(std::equal(list.begin(), list.end(), expected.begin()));
+    assert(list.valid(front) == front_survives);
+    assert(list.remove_if([](int) { return false; }) == 0);
+
+    auto first = list.begin(), last = list.begin();
+    auto expected_first = expected.begin(), expected_last = expected.begin();
+    for (int i = 0; i < 10; ++i, ++first, ++expected_first);
+    for (int i = 0; i < 100; ++i, ++last, ++expected_last);
+    assert(*list.erase_range(first, last) == *expected_last);
+    expected.erase(expected_first, expected_last);
+    assert(list.size() == expected.size());
+    assert(std::equal(list.begin(), list.end(), expected.begin()));
+
+    list.erase_range(list.begin(), list.begin());
+    list.erase_range(--list.end(), list.end());
+    expected.pop_back();
+    assert(list.size() == expected.size() && list.back() == expected.back());
+
+    // freed slots are reused
+    size_t capacity = list.capacity();
+    for (int i = 0; i < 400; ++i)
+        list.push_front(-i);
+    assert(list.capacity() == capacity);
+
+    size_t size = list.size();
+    assert(list.remove_if([](int) { return true; }) == size);
+    assert(list.empty() && list.begin() == list.end());
+    list.push_back(42);
+    assert(list.front() == 42 && list.back() == 42 && list.size() == 1);
+
+    list.erase_range(list.begin(), list.end());
+    assert(list.empty());
+}
+
+
 int main() {
     push_pop_test();
     copy_move_test();
@@ -229,4 +655,12 @@ int main() {
     insert_remove_by_iterators_test();
     indices_test();
     dump_test();
+    unordered_traversal_test();
+    reserve_range_test();
+    handles_test();
+    concurrent_queue_test();
+    persistent_list_test();
+    lru_cache_test();
+    snapshot_list_test();
+    bulk_remove_test();
 }
@@ -8,6 +8,7 @@
 #include <string.h>
 #include <map>
 #include <string>
+#include <vector>
 
 
 struct Function {
@@ -26,27 +27,21 @@ void get_labels(FILE* file, auto& labels) {
 
     while (getline(&buf, &nbuf, file) > 0) {
         make_fin(buf);
-        shift(buf);
+        char* st = buf;
+        shift(st);
         ++line;
 
-        if (buf[0] == ':') {
-            ++buf;
-            if (labels[buf])
-                throw asm_exception(line, get_string("label \"%s\" redefinition", buf));
-            labels[buf] = ip_shift;
-        }
-        else {
-            char* ch = buf;
-            while (*ch && *ch != ' ')
-                ++ch;
-            *ch = 0;
-            for (unsigned char i = 0; i < COMMANDS_NAMES.size(); ++i)
-                if (!strcmp(buf, COMMANDS_NAMES[i])) {
-                    ip_shift += sizeof(unsigned char) + sizeof(double) * ARGS_NUMBERS[i];
-                    break;
-                }
+        if (st[0] == ':') {
+            ++st;
+            if (labels[st])
+                throw asm_exception(line, get_string("label \"%s\" redefinition", st));
+            labels[st] = ip_shift;
         }
+        else
+            ip_shift += line_size(st);
     }
+
+    free(buf);
 }
 
 void get_funcs(FILE* file, auto& funcs) {
@@ -61,70 +56,92 @@ void get_funcs(FILE* file, auto& funcs) {
     while (getline(&buf, &nbuf, file) > 0) {
         ++line;
         make_fin(buf);
-        shift(buf);
+        char* st = buf;
+        shift(st);
+
+        size_t size = line_size(st);
 
-        char* ch = buf;
+        char* ch = st;
         while (*ch && *ch != ' ')
             ++ch;
-        *ch = 0;
         
-        if (!strcmp(buf, "FD")) {
-            buf = ++ch;
-            shift(buf);
+        if (*ch && ch - st == 2 && !strncmp(st, "FD", 2)) {
+            st = ++ch;
+            shift(st);
 
-            ch = buf;
+            ch = st;
             while (*ch && *ch != ' ')
                 ++ch;
             *ch = 0;
             ++ch;
             shift(ch);
 
-            if (!*buf)
+            if (!*st)
                 throw asm_exception(line, "function's name not found");
-            if (funcs[buf].start)
-                throw asm_exception(line, get_string("function \"%s\" redefinition", buf));
+            if (funcs[st].start)
+                throw asm_exception(line, get_string("function \"%s\" redefinition", st));
 
             char* end = nullptr;
-            double nargs = strtod(ch, &end);
+            funcs[st].nargs = strtoul(ch, &end, 10);
             ch = end;
             shift(ch);
-            double nlocals = strtod(ch, &end);
+            funcs[st].nlocals = strtoul(ch, &end, 10);
 
-            funcs[buf].nargs = nargs;
-            funcs[buf].nlocals = nlocals;
-
-            ip_shift += sizeof(unsigned char) + sizeof(double) * (ARGS_NUMBERS[CMD_FD] - 2);
-            funcs[buf].start = ip_shift;
-            ip_shift += sizeof(double) * 2;
-            cur_func_name = buf;
-        }
-        else if (!strcmp(buf, "RET") || !strcmp(buf, "LEAVE")) {
-            ip_shift += sizeof(unsigned char) + sizeof(double);
-            funcs[cur_func_name].endfunc = ip_shift;
+            funcs[st].start = ip_shift;
+            cur_func_name = st;
         }
-        else
-            for (unsigned char i = 0; i < COMMANDS_NAMES.size(); ++i)
-                if (!strcmp(buf, COMMANDS_NAMES[i])) {
-                    ip_shift += sizeof(unsigned char) + sizeof(double) * ARGS_NUMBERS[i];
-                    break;
-                }
+        else if ((ch - st == 3 && !strncmp(st, "RET", 3)) || (ch - st == 5 && !strncmp(st, "LEAVE", 5)) ||
+                 (ch - st == 8 && !strncmp(st, "TAILCALL", 8)))
+            funcs[cur_func_name].endfunc = ip_shift + size;
+
+        ip_shift += size;
     }
+
+    free(buf);
 }
 
 
 
+// --ram cells: log2 of the RAM the program gets, rounded up to a power of two
+static unsigned char ram_log2(const char* cells) {
+    char* end = nullptr;
+    const unsigned long long size = strtoull(cells, &end, 10);
+    unsigned char ram = 1;
+    while (ram <= MAX_RAM_LOG2 && (1ull << ram) < size)
+        ++ram;
+
+    if (*end || !size || ram > MAX_RAM_LOG2) {
+        fprintf(stderr, STYLE("1") "asm: " STYLE("31") "error: " STYLE("0") "--ram: expected 0 < cells <= 2^%d\n",
+                MAX_RAM_LOG2);
+        exit(1);
+    }
+    return ram;
+}
+
+
 int main(int argc, char** argv) {
-    if (argc < 2) {
+    std::vector<const char*> inputs;
+    unsigned char ram = 0;
+    size_t ram_size = RAM_SIZE;
+
+    for (int i = 1; i < argc; ++i)
+        if (!strcmp(argv[i], "--ram") && i + 1 < argc) {
+            ram = ram_log2(argv[++i]);
+            ram_size = (size_t)1 << ram;
+        } else
+            inputs.push_back(argv[i]);
+
+    if (inputs.empty()) {
         fprintf(stderr, STYLE("1") "asm: " STYLE("31") "error: " STYLE("0") "no input files\n");
         exit(1);
     }
 
-    for (int f = 1; f < argc; ++f) {
+    for (const char* input : inputs) {
 
         char filename[1024];
-        snprintf(filename, sizeof(filename), "%s.dk", argv[f]);
+        snprintf(filename, sizeof(filename), "%s.dk", input);
 
-        FILE* raw = fopen(argv[f], "r");
+        FILE* raw = fopen(input, "r");
         if (!raw)
             PANIC();
 
@@ -150,7 +167,7 @@ int main(int argc, char** argv) {
             exit(1);   
         }
 
-        fprintf(compiled, SGN);
+        emit_header(compiled, ram);
 
         char* buf = nullptr;
         size_t nbuf = 0;
@@ -159,22 +176,23 @@ int main(int argc, char** argv) {
         try {
             while (getline(&buf, &nbuf, raw) > 0) {
                 ++line;
-                shift(buf);
-                if (buf[0] == ':' || buf[0] == '#' || buf[0] == '\n')
+                make_fin(buf);
+                char* st = buf;
+                shift(st);
+                if (st[0] == ':' || !st[0])
                     continue;
-                char* ch = buf;
-                char* fin = buf + strlen(buf) - 1;
-                while (ch != fin && *ch != ' ')
+                char* ch = st;
+                while (*ch && *ch != ' ')
                     ++ch;
+                char* args = *ch ? ch + 1 : ch;
                 *ch = 0;
                 for (unsigned char i = 0; i < COMMANDS_NAMES.size(); ++i)
-                    if (!strcmp(buf, COMMANDS_NAMES[i])) {
-                        fwrite(&i, sizeof(unsigned char), 1, compiled);
-                        parse(i, ch + 1, compiled, line, labels, funcs);
+                    if (!strcmp(st, COMMANDS_NAMES[i])) {
+                        parse(i, args, compiled, line, labels, funcs, ram_size);
                         break;
                     }
                     else if (i == COMMANDS_NAMES.size() - 1)
-                        throw asm_exception(line, get_string("command \"%s\" not found", buf));
+                        throw asm_exception(line, get_string("command \"%s\" not found", st));
             }
         } catch (asm_exception& e) {
             fprintf(stderr, STYLE("1") "asm: " STYLE("31") "error:" STYLE("39") "\n"
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "processor.h"
+
+
+// .dk format, version 2:
+//
+//     header:       SGN, u8 version, u8 ram                                (8 bytes)
+//     instruction:  u8 command, u8 mode, u8 reg, u8 0, operands            (multiple of 4 bytes)
+//
+// operands are int32 (jump targets are byte offsets from the beginning of the file),
+// only PUSH of an immediate carries an f64. PUSH and POP have no operand slots in ARGS_NUMBERS terms:
+//     mode 0 - immediate: PUSH f64 value, POP nothing (drops the top)
+//     mode 1 - register:  reg, no operands
+//     mode 2 - RAM:       reg = base register + 1 (0 - no base register), int32 shift
+// CALL, RET and LEAVE refer to the FD of their function, TAILCALL to the FD of the callee.
+// ram: the program gets 2^ram cells of RAM (ram <= MAX_RAM_LOG2), 0 - RAM_SIZE.
+
+constexpr unsigned char BYTECODE_VERSION = 2;
+constexpr size_t BYTECODE_HEADER_SIZE = 8;
+constexpr size_t INSTRUCTION_HEADER_SIZE = 4;
+constexpr size_t RAM_LOG2_OFFSET = 7;
+constexpr unsigned char MAX_RAM_LOG2 = 36;
+
+
+// size of the instruction in bytes, header included
+static constexpr size_t instruction_size(unsigned char command, unsigned char mode) {
+    if (command == CMD_PUSH)
+        return INSTRUCTION_HEADER_SIZE + (mode == 0 ? sizeof(double) : mode == 2 ? sizeof(int32_t) : 0);
+    if (command == CMD_POP)
+        return INSTRUCTION_HEADER_SIZE + (mode == 2 ? sizeof(int32_t) : 0);
+    return INSTRUCTION_HEADER_SIZE + sizeof(int32_t) * ARGS_NUMBERS[command];
+}
+
+
+static inline int32_t read_int(const char* where) {
+    int32_t value = 0;
+    memcpy(&value, where, sizeof(value));
+    return value;
+}
+
+static inline double read_double(const char* where) {
+    double value = 0;
+    memcpy(&value, where, sizeof(value));
+    return value;
+}
+
+
+// prog has to hold a header
+static inline size_t header_ram_size(const char* prog) {
+    const unsigned char ram = prog[RAM_LOG2_OFFSET];
+    return ram ? (size_t)1 << ram : RAM_SIZE;
+}
+
+static inline void emit_header(FILE* out, unsigned char ram = 0) {
+    const unsigned char version[2] = {BYTECODE_VERSION, ram};
+    fwrite(SGN, 1, strlen(SGN), out);
+    fwrite(version, 1, sizeof(version), out);
+}
+
+static inline void emit_command(FILE* out, unsigned char command, unsigned char mode = 0, unsigned char reg = 0) {
+    const unsigned char header[INSTRUCTION_HEADER_SIZE] = {command, mode, reg, 0};
+    fwrite(header, 1, sizeof(header), out);
+}
+
+static inline void emit_int(FILE* out, int32_t value) {
+    fwrite(&value, sizeof(value), 1, out);
+}
+
+static inline void emit_double(FILE* out, double value) {
+    fwrite(&value, sizeof(value), 1, out);
+}
+
+// overwrites an int32 operand written earlier, the position of out is kept
+static inline void patch_int(FILE* out, long offset, int32_t value) {
+    long current = ftell(out);
+    fseek(out, offset, SEEK_SET);
+    emit_int(out, value);
+    fseek(out, current, SEEK_SET);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stddef.h>
+
+
+// Operand stack whose top CACHE_SIZE (0..2) elements live in the members top_ and second_ instead of memory.
+// depth is the number of cached elements. proc generates a copy of every handler for every depth and
+// sets depth to a constant at the start of each, so the branches below fold away and most arithmetic
+// never touches memory. Indices are logical: element i is the same whatever part of the stack is cached.
+// Memory is CheckedStack<T> or, for programs the verifier proved, UncheckedStack<T>.
+template <typename T, size_t CACHE_SIZE, typename Memory>
+class CachedStack {
+    static_assert(CACHE_SIZE <= 2, "only the top two elements can be cached");
+
+public:
+    Memory& memory;
+    size_t depth = 0;
+
+    explicit CachedStack(Memory& memory) : memory(memory) {}
+
+    // item is taken by value, it may refer to a cached element
+    void push(T item) {
+        if (CACHE_SIZE == 0) {
+            memory.push(item);
+            return;
+        }
+
+        if (depth == CACHE_SIZE)
+            memory.push(CACHE_SIZE == 1 ? top_ : second_);
+        else
+            ++depth;
+
+        second_ = top_;
+        top_ = item;
+    }
+
+    T pop() {
+        if (depth == 0)
+            return memory.pop();
+
+        T item = top_;
+        top_ = second_;
+        --depth;
+        return item;
+    }
+
+    size_t size() const {
+        return memory.size() + depth;
+    }
+
+    T& operator[](size_t index) {
+        const size_t stored = memory.size();
+        if (index < stored)
+            return memory[index];
+        return index == stored + depth - 1 ? top_ : second_;
+    }
+
+    T& top() {
+        return depth ? top_ : memory.top();
+    }
+
+    // pushes n default values (zeros), UncheckedStack makes room for all of them at once
+    void grow(size_t n) {
+        if (!n)
+            return;
+
+        if (depth == 2)
+            memory.push(second_);
+        if (depth >= 1)
+            memory.push(top_);
+        depth = 0;
+        memory.grow(n);
+    }
+
+    // pops n elements, UncheckedStack forgets all of them at once
+    void drop(size_t n) {
+        if (n && depth) {
+            const size_t cached = n < depth ? n : depth;
+            if (cached == 1)
+                top_ = second_;
+            depth -= cached;
+            n -= cached;
+        }
+        memory.drop(n);
+    }
+
+private:
+    T top_ = {};
+    T second_ = {};
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include "processor.h"
+
+
+// ../stack/stack.h has no include guard, the includer brings it
+template <typename T>
+class Stack;
+
+
+// Stack (../stack/stack.h) for programs the verifier could not prove. Taking from an empty stack throws
+// runtime_exception instead of failing the assert in Stack.
+template <typename T>
+class CheckedStack : public Stack<T> {
+public:
+    const size_t* ip = nullptr;      // the stack engine's ip while it runs, for the instruction in errors
+
+    const T pop() {
+        if (Stack<T>::empty())
+            underflow_();
+        return Stack<T>::pop();
+    }
+
+    T& top() {
+        if (Stack<T>::empty())
+            underflow_();
+        return Stack<T>::top();
+    }
+
+    // Stack has no bulk operations, its checks see every element
+    void grow(size_t n) {
+        for (size_t i = 0; i < n; ++i)
+            Stack<T>::push(T());
+    }
+
+    void drop(size_t n) {
+        for (size_t i = 0; i < n; ++i)
+            pop();
+    }
+
+private:
+    [[noreturn]] void underflow_() const {
+        throw runtime_exception(ip ? *ip - 1 : SIZE_MAX, "the stack is empty");
+    }
+};
@@ -5,20 +5,26 @@
 #define POP_REG(reg) registers[reg] = POP()
 #define PUSH_MEM(index) PUSH(RAM[index])
 #define POP_MEM(index) RAM[index] = POP()
-#define PUSH_CALL(current_ip) call_stack.push(current_ip)
-#define PUSH_LOCALS_BEGIN(index) locals_begin.push(index)
-#define POP_LOCALS_BEGIN() locals_begin.pop()
-#define LOCALS_BEGIN() locals_begin.top()
-#define POP_CALL() call_stack.pop()
+#define RAM_ADDRESS(in) ((in).reg ? (size_t)registers[(in).reg - 1] + (in).shift : (in).shift)
+#define RAM_INDEX(in) ((in).bounded ? RAM_ADDRESS(in) : \
+    check_ram_index((in).reg ? registers[(in).reg - 1] : 0, (in).shift, RAM.size(), ip - 1))
+// the caller's return address and frame pointer are saved together, fp is where the callee's locals begin
+#define PUSH_FRAME(return_ip) \
+    do { \
+        call_stack.push({(return_ip), fp}); \
+        fp = stack.size(); \
+    } while (0)
+#define POP_FRAME() \
+    do { \
+        const StackFrame frame = call_stack.pop(); \
+        ip = frame.ip; \
+        fp = frame.fp; \
+    } while (0)
+#define LOCAL(offset) stack[fp + (offset)]
+#define TOP() stack.top()
 #define let double
-#define READ() ({ \
-    let a = 0; \
-    scanf("%lf", &a); \
-    a; \
-})
-#define WRITE(a) { \
-    printf("%lf\n", a); \
-}
+#define READ() io.read()
+#define WRITE(a) io.write(a)
 #define _EPS 1e-6
 #define ABS(a) ((a) >= 0 ? (a) : -(a))
 #define _EQUAL(a, b) (ABS((a) - (b)) <= _EPS)
@@ -27,23 +33,19 @@
 
 
 DEF_CMD(END, 0, {
-    return 0;
+    HALT();
 })
 
 DEF_CMD(PUSH, 2, {
-    let reg   = (int)args[1] % (__REGISTERS_NUMBER__ + 1) - 1;
-    let shift = (int)args[1] / (__REGISTERS_NUMBER__ + 1);
-    args[0] == 0 ? PUSH(args[1]) : 
-    args[0] == 1 ? PUSH_REG(args[1]) :
-                   PUSH_MEM(registers[reg] + shift);
+    in.mode == 0 ? PUSH(in.value) : 
+    in.mode == 1 ? PUSH_REG(in.reg) :
+                   PUSH_MEM(RAM_INDEX(in));
 })
 
 DEF_CMD(POP, 2, {
-    let reg = (int)args[1] % (__REGISTERS_NUMBER__ + 1) - 1;
-    let shift = (int)args[1] / (__REGISTERS_NUMBER__ + 1);
-    args[0] == 0 ? POP() : 
-    args[0] == 1 ? POP_REG(args[1]) :
-                   POP_MEM(registers[reg] + shift);
+    in.mode == 0 ? POP() : 
+    in.mode == 1 ? POP_REG(in.reg) :
+                   POP_MEM(RAM_INDEX(in));
 })
 
 DEF_CMD(ADD, 0, {
@@ -92,43 +94,43 @@ DEF_CMD(OUT, 0, {
 })
 
 DEF_CMD(JMP, 1, {
-    ip = (int)args[0];
+    ip = in.target;
 })
 
 DEF_CMD(JA, 1, {
     let a = POP();
     let b = POP();
-    if (GRT(b, a)) ip = (int)args[0];
+    if (GRT(b, a)) ip = in.target;
 })
 
 DEF_CMD(JAE, 1, {
     let a = POP();
     let b = POP();
-    if (!LESS(b, a)) ip = (int)args[0];
+    if (!LESS(b, a)) ip = in.target;
 })
 
 DEF_CMD(JB, 1, {
     let a = POP();
     let b = POP();
-    if (LESS(b, a)) ip = (int)args[0];
+    if (LESS(b, a)) ip = in.target;
 })
 
 DEF_CMD(JBE, 1, {
     let a = POP();
     let b = POP();
-    if (!GRT(b, a)) ip = (int)args[0];
+    if (!GRT(b, a)) ip = in.target;
 })
 
 DEF_CMD(JE, 1, {
     let a = POP();
     let b = POP();
-    if (_EQUAL(b, a)) ip = (int)args[0];
+    if (_EQUAL(b, a)) ip = in.target;
 })
 
 DEF_CMD(JNE, 1, {
     let a = POP();
     let b = POP();
-    if (!_EQUAL(b, a)) ip = (int)args[0];
+    if (!_EQUAL(b, a)) ip = in.target;
 })
 
 DEF_CMD(INC, 0, {
@@ -211,64 +213,42 @@ DEF_CMD(EXP, 0, {
 })
 
 DEF_CMD(CALL, 1, {
-    PUSH_CALL(ip);
-    ip = (int)args[0];
-    PUSH_LOCALS_BEGIN(stack.size());
-
-    // nargs
-    ip += sizeof(double);
-    
-    let nlocals = *(double*)(prog + ip);
-    for (size_t i = 0; i < nlocals; ++i)
-        PUSH(0);
-    ip += sizeof(double);
+    PUSH_FRAME(ip);
+    ip = in.target;
+    stack.grow(in.nlocals);
 })
 
 DEF_CMD(LEAVE, 1, {
-    ip = POP_CALL();
-    POP_LOCALS_BEGIN();
-
-    let nargs = *(double*)(prog + (int)args[0]);
-    let nlocals = *((double*)(prog + (int)args[0]) + 1);
-
-    for (size_t i = 0; i < nargs + nlocals; ++i)
-        POP();
+    POP_FRAME();
+    stack.drop(in.nargs + in.nlocals);
 })
 
 DEF_CMD(RET, 1, {
-    ip = POP_CALL();
-    POP_LOCALS_BEGIN();
-
-    let nargs = *(double*)(prog + (int)args[0]);
-    let nlocals = *((double*)(prog + (int)args[0]) + 1);
+    POP_FRAME();
 
     let tmp = POP();
-
-    for (size_t i = 0; i < nargs + nlocals; ++i)
-        POP();
-
+    stack.drop(in.nargs + in.nlocals);
     PUSH(tmp);
 })
 
 DEF_CMD(FD, 3, {
-    ip = (int)args[0];
+    ip = in.target;
 })
 
 DEF_CMD(DRAW, 3, {
-    fwritebmp(fopen("proc_picture.bmp", "w"), 
-              (int)args[0], (int)args[1], RAM.data(), RAM.data() + (int)args[2]);
+    io.draw(in.draw.width, in.draw.height, RAM.data(), RAM.data() + in.draw.ndata);
 })
 
 DEF_CMD(GET_LOCAL, 1, {
-    PUSH(stack[LOCALS_BEGIN() + (size_t)args[0]]);
+    PUSH(LOCAL(in.target));
 })
 
 DEF_CMD(SET_LOCAL, 1, {
-    stack[LOCALS_BEGIN() + (size_t)args[0]] = POP();
+    LOCAL(in.target) = POP();
 })
 
 DEF_CMD(GET_ARG, 1, {
-    PUSH(stack[LOCALS_BEGIN() - 1 - (int)args[0]]);
+    PUSH(LOCAL(-1 - in.target));
 })
 
 DEF_CMD(PASS, 0, {})
@@ -309,14 +289,133 @@ DEF_CMD(GE, 0, {
     PUSH((double)!LESS(b, a));
 })
 
+// CALL; RET in one frame: the arguments on the top take the place of the current function's (in.shift of
+// them), the rest of its frame is dropped and the callee returns straight to where the current one would
+DEF_CMD(TAILCALL, 1, {
+    const size_t base = fp - in.shift;
+    const size_t args = stack.size() - in.nargs;
+    for (int i = 0; i < in.nargs; ++i)
+        stack[base + i] = stack[args + i];
+
+    stack.drop(args - base);
+    fp = stack.size();
+    ip = in.target;
+    stack.grow(in.nlocals);
+})
+
+// vector commands over RAM: n cells from dst, a and b (vector.h), the verifier checked the ranges
+DEF_CMD(VADD, 4, {
+    vector_add(&RAM[in.vector.dst], &RAM[in.vector.a], &RAM[in.vector.b], in.vector.n);
+})
+
+DEF_CMD(VSUB, 4, {
+    vector_sub(&RAM[in.vector.dst], &RAM[in.vector.a], &RAM[in.vector.b], in.vector.n);
+})
+
+DEF_CMD(VMUL, 4, {
+    vector_mul(&RAM[in.vector.dst], &RAM[in.vector.a], &RAM[in.vector.b], in.vector.n);
+})
+
+DEF_CMD(VDIV, 4, {
+    vector_div(&RAM[in.vector.dst], &RAM[in.vector.a], &RAM[in.vector.b], in.vector.n);
+})
+
+DEF_CMD(VFILL, 2, {
+    vector_fill(&RAM[in.vector.dst], POP(), in.vector.n);
+})
+
+DEF_CMD(VSCALE, 3, {
+    vector_scale(&RAM[in.vector.dst], &RAM[in.vector.a], POP(), in.vector.n);
+})
+
+DEF_CMD(VDOT, 3, {
+    PUSH(vector_dot(&RAM[in.vector.a], &RAM[in.vector.b], in.vector.n));
+})
+
+DEF_CMD(VSUM, 2, {
+    PUSH(vector_sum(&RAM[in.vector.a], in.vector.n));
+})
+
+
+// superinstructions: never stored in .dk files, made from the sequences in the comments by fuser.h
+#ifdef DEF_FUSED
+
+// GET_LOCAL target; GET_LOCAL shift; <op>
+DEF_FUSED(GET_LOCALS_ADD, {
+    PUSH(LOCAL(in.target) + LOCAL(in.shift));
+})
+
+DEF_FUSED(GET_LOCALS_SUB, {
+    PUSH(LOCAL(in.target) - LOCAL(in.shift));
+})
+
+DEF_FUSED(GET_LOCALS_MUL, {
+    PUSH(LOCAL(in.target) * LOCAL(in.shift));
+})
+
+DEF_FUSED(GET_LOCALS_DIV, {
+    PUSH(LOCAL(in.target) / LOCAL(in.shift));
+})
+
+// PUSH value; <op>
+DEF_FUSED(PUSH_ADD, {
+    PUSH(POP() + in.value);
+})
+
+DEF_FUSED(PUSH_SUB, {
+    PUSH(POP() - in.value);
+})
+
+DEF_FUSED(PUSH_MUL, {
+    PUSH(POP() * in.value);
+})
+
+DEF_FUSED(PUSH_DIV, {
+    PUSH(POP() / in.value);
+})
+
+// GET_LOCAL target; PUSH value; <op>; SET_LOCAL target
+DEF_FUSED(LOCAL_ADD, {
+    LOCAL(in.target) += in.value;
+})
+
+DEF_FUSED(LOCAL_SUB, {
+    LOCAL(in.target) -= in.value;
+})
+
+DEF_FUSED(LOCAL_MUL, {
+    LOCAL(in.target) *= in.value;
+})
+
+DEF_FUSED(LOCAL_DIV, {
+    LOCAL(in.target) /= in.value;
+})
+
+// SET_LOCAL target; GET_LOCAL target
+DEF_FUSED(TEE_LOCAL, {
+    LOCAL(in.target) = TOP();
+})
+
+// PUSH 0; JE target
+DEF_FUSED(JZ, {
+    let a = POP();
+    if (_EQUAL(a, 0)) ip = in.target;
+})
+
+#endif
+
 #undef PUSH
 #undef POP
 #undef PUSH_REG
 #undef POP_REG
 #undef PUSH_MEM
 #undef POP_MEM
-#undef POP_CALL
-#undef PUSH_CALL
+#undef RAM_ADDRESS
+#undef RAM_INDEX
+#undef LOCAL
+#undef TOP
+#undef PUSH_FRAME
+#undef POP_FRAME
 #undef READ
 #undef WRITE
 #undef let
@@ -6,6 +6,7 @@
 #include "processor.h"
 #include "reader.h"
 #include "verificator.h"
+#include "bytecode.h"
 
 
 int main(int argc, char** argv) {
@@ -35,84 +36,42 @@ int main(int argc, char** argv) {
         if (!raw)
             PANIC();
 
-        std::map<int, int> lines_begin;
-        int line = 0;
         int indent = 0;
 
-        const char* cur = prog + strlen(SGN);
+        const char* cur = prog + BYTECODE_HEADER_SIZE;
         const char* fin = prog + size;
         
-        double tmp[__MAXIMAL_ARGS_NUMBER__];
         while (cur != fin) {
-            lines_begin[cur - prog] = ++line;
-            unsigned char index = *(unsigned char*)cur;
+            unsigned char index = cur[0], mode = cur[1], reg = cur[2];
+            const char* operands = cur + INSTRUCTION_HEADER_SIZE;
             
-            if (index == CMD_RET || index == CMD_LEAVE)
+            if (index == CMD_RET || index == CMD_LEAVE || index == CMD_TAILCALL)
                 --indent;
             
             fprintf(raw, "%*s%s", indent * 2, "", COMMANDS_NAMES[index]);
-            ++cur;
-            for (size_t i = 0; i < ARGS_NUMBERS[index]; ++i) {
-                tmp[i] = *(double*)cur;
-                if (index == CMD_PUSH) {
-                    if (i == 1) {
-                        switch ((int)tmp[0]) {
-                            case 0:
-                                fprintf(raw, " %lf", *(double*)cur);
-                                break;
-                            case 1:
-                                fprintf(raw, " %s", REGISTERS_NAMES[*(double*)cur]);
-                                break;
-                            case 2:
-                                size_t shift = (size_t)tmp[1] / (__REGISTERS_NUMBER__ + 1),
-                                       reg = (size_t)tmp[1] % (__REGISTERS_NUMBER__ + 1);
-                                if (!reg)
-                                    fprintf(raw, " [%zu]", shift);
-                                else if (!shift)
-                                    fprintf(raw, " [%s]", REGISTERS_NAMES[reg - 1]);
-                                else
-                                    fprintf(raw, " [%s+%zu]", REGISTERS_NAMES[reg - 1], shift);
-                                break;
-                        }
-                    }
-                }
-                else if (index == CMD_POP) {
-                    if (i == 1) {
-                        switch ((int)tmp[0]) {
-                            case 0:
-                                break;
-                            case 1:
-                                fprintf(raw, " %s", REGISTERS_NAMES[tmp[1]]);
-                                break;
-                            case 2:
-                                size_t shift = (size_t)tmp[1] / (__REGISTERS_NUMBER__ + 1),
-                                       reg = (size_t)tmp[1] % (__REGISTERS_NUMBER__ + 1);
-                                if (!reg)
-                                    fprintf(raw, " [%zu]", shift);
-                                else if (!shift)
-                                    fprintf(raw, " [%s]", REGISTERS_NAMES[reg - 1]);
-                                else
-                                    fprintf(raw, " [%s+%zu]", REGISTERS_NAMES[reg - 1], shift);
-                                break;
-                        }
-                    }
-                }
-                // else if (index == CMD_JMP || index == CMD_JA || index == CMD_JB || index == CMD_JE || 
-                //          index == CMD_JNE || index == CMD_JAE || index == CMD_JBE)
-                //     fprintf(raw, " %d", lines_begin[(int)tmp[0]]);
-                // else if (index == CMD_CALL)
-                //     fprintf(raw, " f%d", lines_begin[(int)tmp[0]]);
-                else
-                    fprintf(raw, " %lf", *(double*)cur);
-                // if (i == 1 && index == CMD_FD)
-                //     fprintf(raw, " (f%d)", lines_begin[(int)tmp[0]]);
-                cur += sizeof(double);
+
+            if (index == CMD_PUSH || index == CMD_POP) {
+                int shift = mode == 2 ? read_int(operands) : 0;
+                if (mode == 0 && index == CMD_PUSH)
+                    fprintf(raw, " %lf", read_double(operands));
+                else if (mode == 1)
+                    fprintf(raw, " %s", REGISTERS_NAMES[reg]);
+                else if (mode == 2 && !reg)
+                    fprintf(raw, " [%d]", shift);
+                else if (mode == 2 && !shift)
+                    fprintf(raw, " [%s]", REGISTERS_NAMES[reg - 1]);
+                else if (mode == 2)
+                    fprintf(raw, " [%s+%d]", REGISTERS_NAMES[reg - 1], shift);
             }
+            else
+                for (size_t i = 0; i < ARGS_NUMBERS[index]; ++i)
+                    fprintf(raw, " %d", read_int(operands + i * sizeof(int32_t)));
 
             if (index == CMD_FD) 
                 ++indent;
             
             fprintf(raw, "\n");
+            cur += instruction_size(index, mode);
         }
     }
 }
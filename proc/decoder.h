@@ -0,0 +1,187 @@
+#pragma once
+
+#include <vector>
+#include <string.h>
+#include "processor.h"
+#include "bytecode.h"
+
+
+// operands of DRAW
+struct DrawOperands {
+    int width, height;
+    int ndata;               // RAM cells before the picture
+};
+
+// operands of a vector command: the RAM ranges dst, a, b of n cells, -1 - the command does not have it
+struct VectorRanges {
+    int dst, a, b;
+    int n;
+};
+
+
+// one instruction of a verified program with its operands already converted to the types the handlers use
+struct Instruction {
+    unsigned char command;
+    unsigned char mode;      // PUSH, POP: 0 - immediate (POP: drop), 1 - register, 2 - RAM
+    unsigned char reg;       // PUSH, POP: register (mode 1) or RAM base register + 1, 0 - no base (mode 2)
+    union {
+        struct {
+            int target;      // jumps, FD: instruction index; CALL, TAILCALL: first instruction of the body;
+                             // GET_LOCAL, SET_LOCAL, GET_ARG: offset
+            int shift;       // PUSH, POP: RAM offset; TAILCALL: arguments of the function it is in
+            int nargs;       // CALL, RET, LEAVE, TAILCALL: frame of the function
+            int nlocals;     // FD, CALL, RET, LEAVE, TAILCALL: locals of the function
+        };
+        DrawOperands draw;
+        VectorRanges vector;
+    };
+    double value;            // PUSH: immediate
+    bool bounded;            // PUSH, POP [reg+shift]: the verifier proved the address is inside RAM
+};
+
+
+inline bool is_jump(unsigned char command) {
+    return command == CMD_JMP ||
+           command == CMD_JA || command == CMD_JB || command == CMD_JNE ||
+           command == CMD_JAE || command == CMD_JBE || command == CMD_JE;
+}
+
+
+// VADD, VSUB, VMUL, VDIV dst a b n; VSCALE dst a n; VFILL dst n; VDOT a b n; VSUM a n
+inline bool is_vector(unsigned char command) {
+    return command == CMD_VADD || command == CMD_VSUB || command == CMD_VMUL || command == CMD_VDIV ||
+           command == CMD_VFILL || command == CMD_VSCALE || command == CMD_VDOT || command == CMD_VSUM;
+}
+
+
+// the ranges of a vector command are dst (0), a (1), b (2); it has those from first to last
+inline int vector_first(unsigned char command) {
+    return command == CMD_VDOT || command == CMD_VSUM;
+}
+
+inline int vector_last(unsigned char command) {
+    return command == CMD_VFILL ? 0 : command == CMD_VSCALE || command == CMD_VSUM ? 1 : 2;
+}
+
+
+struct VectorOperands {
+    int first[3];            // cell each range starts from, -1 - the command does not have it
+    int n;
+};
+
+inline VectorOperands read_vector_operands(unsigned char command, const char* operands) {
+    VectorOperands vector = {{-1, -1, -1}, 0};
+    for (int i = vector_first(command); i <= vector_last(command); ++i, operands += sizeof(int32_t))
+        vector.first[i] = read_int(operands);
+    vector.n = read_int(operands);
+    return vector;
+}
+
+
+// turns a byte offset into the index of the instruction starting there, end of the program is allowed
+inline int instruction_at(const std::vector<int>& indices, size_t offset, size_t byte, unsigned char command) {
+    if (offset >= indices.size() || indices[offset] < 0)
+        throw verificator_exception(byte,
+                    get_string("%s: pointer %zu is not at the beginning of an instruction",
+                               COMMANDS_NAMES[command], offset));
+    return indices[offset];
+}
+
+
+// CALL, RET and LEAVE refer to the FD of the function
+inline int function_at(const std::vector<int>& indices, const std::vector<Instruction>& code,
+                       size_t offset, size_t byte, unsigned char command) {
+    if (offset >= indices.size() || indices[offset] < 0 || (size_t)indices[offset] == code.size() ||
+        code[indices[offset]].command != CMD_FD)
+            throw verificator_exception(byte,
+                        get_string("%s: pointer %zu does not refer to a function", COMMANDS_NAMES[command], offset));
+    return indices[offset];
+}
+
+
+// byte offset of every instruction of a verified program, in the order decode() gives them
+inline std::vector<size_t> instruction_offsets(const char* prog, size_t size) {
+    std::vector<size_t> offsets;
+    for (size_t cur = BYTECODE_HEADER_SIZE; cur != size; cur += instruction_size(prog[cur], prog[cur + 1]))
+        offsets.push_back(cur);
+    return offsets;
+}
+
+
+// prog has to be verified already
+inline std::vector<Instruction> decode(const char* prog, size_t size) {
+    std::vector<Instruction> code;
+    std::vector<size_t> offsets;
+    std::vector<int> indices(size + 1, -1);
+
+    for (size_t cur = BYTECODE_HEADER_SIZE; cur != size; ) {
+        indices[cur] = code.size();
+        offsets.push_back(cur);
+
+        Instruction in = {};
+        in.command = prog[cur];
+        in.mode = prog[cur + 1];
+        in.reg = prog[cur + 2];
+        code.push_back(in);
+
+        cur += instruction_size(in.command, in.mode);
+    }
+    indices[size] = code.size();
+
+    for (size_t i = 0; i < code.size(); ++i) {
+        Instruction& in = code[i];
+        const size_t byte = offsets[i];
+        const char* operands = prog + byte + INSTRUCTION_HEADER_SIZE;
+
+        if (in.command == CMD_PUSH && in.mode == 0)
+            in.value = read_double(operands);
+        else if ((in.command == CMD_PUSH || in.command == CMD_POP) && in.mode == 2)
+            in.shift = read_int(operands);
+        else if (is_jump(in.command) || in.command == CMD_FD)
+            in.target = instruction_at(indices, read_int(operands), byte, in.command);
+        else if (in.command == CMD_GET_LOCAL || in.command == CMD_SET_LOCAL || in.command == CMD_GET_ARG)
+            in.target = read_int(operands);
+        else if (in.command == CMD_DRAW) {
+            in.draw.width = read_int(operands);
+            in.draw.height = read_int(operands + sizeof(int32_t));
+            in.draw.ndata = read_int(operands + 2 * sizeof(int32_t));
+        }
+        else if (is_vector(in.command)) {
+            const VectorOperands vector = read_vector_operands(in.command, operands);
+            in.vector = {vector.first[0], vector.first[1], vector.first[2], vector.n};
+        }
+
+        if (in.command == CMD_FD) {
+            in.nargs = read_int(operands + sizeof(int32_t));
+            in.nlocals = read_int(operands + 2 * sizeof(int32_t));
+        }
+    }
+
+    // every FD is decoded by now; open holds the FDs whose bodies contain the instruction
+    std::vector<int> open;
+    for (size_t i = 0; i < code.size(); ++i) {
+        Instruction& in = code[i];
+        while (!open.empty() && (size_t)code[open.back()].target <= i)
+            open.pop_back();
+        if (in.command == CMD_FD)
+            open.push_back(i);
+
+        if (in.command != CMD_CALL && in.command != CMD_RET && in.command != CMD_LEAVE && in.command != CMD_TAILCALL)
+            continue;
+
+        const size_t byte = offsets[i];
+        const int fd = function_at(indices, code, read_int(prog + byte + INSTRUCTION_HEADER_SIZE), byte, in.command);
+
+        in.target = fd + 1;
+        in.nargs = code[fd].nargs;
+        in.nlocals = code[fd].nlocals;
+
+        if (in.command == CMD_TAILCALL) {
+            if (open.empty())
+                throw verificator_exception(byte, "TAILCALL outside of a function");
+            in.shift = code[open.back()].nargs;
+        }
+    }
+
+    return code;
+}
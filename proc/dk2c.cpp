@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tuple>
+#include <math.h>
+#include "processor.h"
+#include "reader.h"
+#include "verificator.h"
+#include "decoder.h"
+#include "translator.h"
+
+
+// Ahead-of-time translation of .dk programs to C: dk2c prog.dk writes prog.dk.c, which builds with
+// cc -O2 prog.dk.c -lm. The program goes through the translator of the register engine, every instruction
+// becomes a block with its operands as constants and the body of its handler from register_commands.h,
+// so the C compiler sees the same expressions as proc. Jumps are gotos, CALL and RET keep frames and
+// return sites on an explicit stack.
+
+
+// handlers as text, the macros they use are defined in PRELUDE
+static const char* const HANDLERS[] = {
+
+#define DEF_ROP(cmd, code) #code,
+#include "register_commands.h"
+#undef DEF_ROP
+
+};
+
+
+static const char* const PRELUDE = R"(#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define let double
+#define R(index) frame[index]
+#define RAM_ADDRESS(in) ((in).reg ? (size_t)registers[(in).reg - 1] + (in).shift : (in).shift)
+#define RAM_INDEX(in) ((in).bounded ? RAM_ADDRESS(in) : \
+    dk_check_ram_index((in).reg ? registers[(in).reg - 1] : 0, (in).shift, (in).origin))
+#define HALT() goto halt
+#define READ() dk_read()
+#define WRITE(a) { \
+    printf("%%lf\n", a); \
+}
+#define _EPS 1e-6
+#define ABS(a) ((a) >= 0 ? (a) : -(a))
+#define _EQUAL(a, b) (ABS((a) - (b)) <= _EPS)
+#define LESS(a, b) ((a) + _EPS < (b))
+#define GRT(a, b) ((b) + _EPS < (a))
+
+struct instruction {
+    unsigned char reg;
+    unsigned char bounded;
+    int origin;
+    int dst, a, b;
+    union {
+        struct {
+            int target, shift, nargs, nlocals;
+        };
+        struct {
+            int width, height, ndata;
+        } draw;
+        struct {
+            int dst, a, b, n;
+        } vector;
+    };
+    int size;
+    double k;
+};
+
+struct call {
+    int site;
+    size_t fp;
+};
+
+static double registers[%d];
+static double RAM[%zu];
+
+static double* file;
+static size_t file_size;
+static struct call* calls;
+static size_t ncalls, calls_capacity;
+
+
+static double dk_read(void) {
+    double a = 0;
+    scanf("%%lf", &a);
+    return a;
+}
+
+/* check_ram_index of proc */
+static size_t dk_check_ram_index(double base, int shift, size_t instruction) {
+    const size_t ram_size = sizeof(RAM) / sizeof(RAM[0]);
+    const double index = trunc(base) + shift;
+    if (!(index >= 0 && index < (double)ram_size)) {
+        fprintf(stderr, "instruction %%zu: RAM index %%.17lg is out of range (RAM size = %%zu)\n",
+                instruction, index, ram_size);
+        exit(1);
+    }
+    return (size_t)index;
+}
+
+static double dk_double(uint64_t bits) {
+    double value = 0;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void* dk_grow(void* array, size_t* capacity, size_t need, size_t item) {
+    if (need <= *capacity)
+        return array;
+    *capacity = 2 * need;
+    array = realloc(array, *capacity * item);
+    if (!array) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return array;
+}
+
+static void dk_write2(FILE* out, uint16_t x) {
+    fwrite(&x, 1, sizeof(x), out);
+}
+
+static void dk_write4(FILE* out, uint32_t x) {
+    fwrite(&x, 1, sizeof(x), out);
+}
+
+/* the same file as fwritebmp of proc */
+static void dk_draw(uint16_t width, uint16_t height, size_t ndata) {
+    FILE* out = fopen("proc_picture.bmp", "w");
+    const unsigned bits_per_pixel = ndata * 8 / width / height;
+
+    fputs("BM", out);
+    dk_write4(out, ndata + 26);
+    dk_write4(out, 0);
+    dk_write4(out, 26);
+    dk_write4(out, 12);
+    dk_write2(out, width);
+    dk_write2(out, height);
+    dk_write2(out, 1);
+    dk_write2(out, bits_per_pixel);
+    for (size_t i = 0; i < ndata; ++i)
+        fputc((unsigned char)RAM[i], out);
+    fclose(out);
+}
+
+/* the scalar kernels of vector.h, the same lanes for VDOT and VSUM */
+#define VECTOR_LANES 16
+
+static double vector_lanes_sum(const double* lane) {
+    double quarter[4];
+    for (int j = 0; j < 4; ++j)
+        quarter[j] = (lane[j] + lane[4 + j]) + (lane[8 + j] + lane[12 + j]);
+    return (quarter[0] + quarter[1]) + (quarter[2] + quarter[3]);
+}
+
+#define DEF_VECTOR_BINARY(name, op) \
+    static void vector_##name(double* dst, const double* a, const double* b, size_t n) { \
+        for (size_t i = 0; i < n; ++i) \
+            dst[i] = a[i] op b[i]; \
+    }
+
+DEF_VECTOR_BINARY(add, +)
+DEF_VECTOR_BINARY(sub, -)
+DEF_VECTOR_BINARY(mul, *)
+DEF_VECTOR_BINARY(div, /)
+
+static void vector_fill(double* dst, double k, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = k;
+}
+
+static void vector_scale(double* dst, const double* a, double k, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = a[i] * k;
+}
+
+static double vector_dot(const double* a, const double* b, size_t n) {
+    double lane[VECTOR_LANES] = {0};
+    for (size_t i = 0; i < n; ++i)
+        lane[i %% VECTOR_LANES] += a[i] * b[i];
+    return vector_lanes_sum(lane);
+}
+
+static double vector_sum(const double* a, size_t n) {
+    double lane[VECTOR_LANES] = {0};
+    for (size_t i = 0; i < n; ++i)
+        lane[i %% VECTOR_LANES] += a[i];
+    return vector_lanes_sum(lane);
+}
+
+
+int main(void) {
+    size_t fp = 0;
+    file = (double*)dk_grow(NULL, &file_size, %zu, sizeof(double));
+    double* frame = file;
+    int site = 0;
+
+)";
+
+
+static void print_constant(FILE* out, double value) {
+    if (isfinite(value))
+        fprintf(out, "%a", value);
+    else {
+        uint64_t bits = 0;
+        memcpy(&bits, &value, sizeof(bits));
+        fprintf(out, "dk_double(0x%llxull)", (unsigned long long)bits);
+    }
+}
+
+static void print_operands(FILE* out, const RegisterInstruction& in) {
+    fprintf(out, "        const struct instruction in = {%d, %d, %d, %d, %d, %d, ",
+            in.reg, in.bounded, in.origin, in.dst, in.a, in.b);
+    if (in.command >= RCMD_VADD && in.command <= RCMD_VSUM)
+        fprintf(out, "{.vector = {%d, %d, %d, %d}}, ", in.vector.dst, in.vector.a, in.vector.b, in.vector.n);
+    else
+        fprintf(out, "{{%d, %d, %d, %d}}, ", in.target, in.shift, in.nargs, in.nlocals);
+    fprintf(out, "%d, ", in.size);
+    print_constant(out, in.k);
+    fprintf(out, "};\n");
+}
+
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, STYLE("1") "dk2c: " STYLE("31") "error: " STYLE("0") "no input files\n");
+        exit(1);
+    }
+
+    for (int f = 1; f < argc; ++f) {
+        const char* prog = nullptr;
+        size_t size = 0;
+
+        std::tie(prog, size) = read_text(argv[f]);
+
+        RegisterProgram program;
+        try {
+            verify(prog, size);
+            std::vector<Instruction> decoded = decode(prog, size);
+            StackAnalysis analysis = StackVerifier(decoded, header_ram_size(prog)).analyze();
+            program = RegisterTranslator(decoded, analysis).translate();
+        } catch (verificator_exception& e) {
+            fprintf(stderr, STYLE("1") "dk2c: " STYLE("31") "error:" STYLE("39") "\n"
+                            "    byte %zu: " STYLE("0") "%s\n",
+                    e.byte, e.what());
+            exit(1);
+        } catch (translator_exception& e) {
+            fprintf(stderr, STYLE("1") "dk2c: " STYLE("31") "error:" STYLE("39") "\n"
+                            "    instruction %zu: " STYLE("0") "%s\n",
+                    e.instruction, e.what());
+            exit(1);
+        }
+
+        char filename[1024];
+        snprintf(filename, sizeof(filename), "%s.c", argv[f]);
+        FILE* out = fopen(filename, "w");
+        if (!out)
+            PANIC();
+
+        fprintf(out, "/* generated by dk2c from %s */\n\n", argv[f]);
+        fprintf(out, PRELUDE, __REGISTERS_NUMBER__, header_ram_size(prog), std::max<size_t>(program.size, 1));
+
+        int sites = 0;
+        for (size_t i = 0; i < program.code.size(); ++i) {
+            const RegisterInstruction& in = program.code[i];
+            fprintf(out, "L%zu: {\n", i);
+
+            switch (in.command) {
+                case RCMD_HALT:
+                    fprintf(out, "        goto halt;\n");
+                    break;
+
+                case RCMD_JMP:
+                    fprintf(out, "        goto L%d;\n", in.target);
+                    break;
+
+                case RCMD_CALL:
+                    fprintf(out, "        calls = (struct call*)dk_grow(calls, &calls_capacity, ncalls + 1, sizeof(struct call));\n"
+                                 "        calls[ncalls].site = %d;\n"
+                                 "        calls[ncalls++].fp = fp;\n"
+                                 "        fp += %d;\n"
+                                 "        file = (double*)dk_grow(file, &file_size, fp + %d, sizeof(double));\n"
+                                 "        frame = file + fp;\n"
+                                 "        for (int i = 0; i < %d; ++i)\n"
+                                 "            R(i) = 0;\n"
+                                 "        goto L%d;\n"
+                                 "    }\n"
+                                 "S%d: {\n",
+                            sites, in.shift, in.size, in.nlocals, in.target, sites);
+                    ++sites;
+                    break;
+
+                case RCMD_TAILCALL:
+                    fprintf(out, "        for (int i = 0; i < %d; ++i)\n"
+                                 "            R(%d + i) = R(%d + i);\n"
+                                 "        fp += %d;\n"
+                                 "        file = (double*)dk_grow(file, &file_size, fp + %d, sizeof(double));\n"
+                                 "        frame = file + fp;\n"
+                                 "        for (int i = 0; i < %d; ++i)\n"
+                                 "            R(i) = 0;\n"
+                                 "        goto L%d;\n",
+                            in.nargs, in.dst, in.a, in.shift, in.size, in.nlocals, in.target);
+                    break;
+
+                case RCMD_RET:
+                    fprintf(out, "        R(%d) = R(%d);\n"
+                                 "        goto ret;\n", -in.nargs, in.a);
+                    break;
+
+                case RCMD_LEAVE:
+                    fprintf(out, "        goto ret;\n");
+                    break;
+
+                case RCMD_DRAW:
+                    fprintf(out, "        dk_draw(%d, %d, %d);\n", in.draw.width, in.draw.height, in.draw.ndata);
+                    break;
+
+                case RCMD_JA_RR: case RCMD_JA_RK: case RCMD_JA_KR:
+                case RCMD_JAE_RR: case RCMD_JAE_RK: case RCMD_JAE_KR:
+                case RCMD_JB_RR: case RCMD_JB_RK: case RCMD_JB_KR:
+                case RCMD_JBE_RR: case RCMD_JBE_RK: case RCMD_JBE_KR:
+                case RCMD_JE_RR: case RCMD_JE_RK: case RCMD_JE_KR:
+                case RCMD_JNE_RR: case RCMD_JNE_RK: case RCMD_JNE_KR:
+                    print_operands(out, in);
+                    fprintf(out, "        size_t ip = (size_t)-1;\n"
+                                 "        %s\n"
+                                 "        if (ip != (size_t)-1)\n"
+                                 "            goto L%d;\n", HANDLERS[in.command], in.target);
+                    break;
+
+                default:
+                    print_operands(out, in);
+                    fprintf(out, "        %s\n", HANDLERS[in.command]);
+                    break;
+            }
+
+            fprintf(out, "    }\n");
+        }
+
+        fprintf(out, "\nret: {\n"
+                     "        struct call call = calls[--ncalls];\n"
+                     "        fp = call.fp;\n"
+                     "        frame = file + fp;\n"
+                     "        site = call.site;\n"
+                     "    }\n"
+                     "    switch (site) {\n");
+        for (int s = 0; s < sites; ++s)
+            fprintf(out, "        case %d: goto S%d;\n", s, s);
+        fprintf(out, "    }\n"
+                     "\nhalt:\n"
+                     "    return 0;\n"
+                     "}\n");
+
+        fclose(out);
+    }
+}
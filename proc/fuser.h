@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+#include "processor.h"
+#include "decoder.h"
+
+
+// Load-time pass that replaces the hottest instruction sequences of decoded programs with superinstructions
+// (DEF_FUSED in commands.h). They were picked by counting instruction pairs and triples over programs made
+// by the derivative compiler: locals are read in pairs before arithmetic, constants are pushed right
+// before arithmetic, compound assignments are GET_LOCAL a; PUSH c; <op>; SET_LOCAL a, an assignment is
+// often followed by a read of the same variable, and every if is <condition>; PUSH 0; JE.
+
+
+// 0..3 for ADD, SUB, MUL, DIV, -1 for the rest
+static int arithmetic_index(unsigned char command) {
+    return command == CMD_ADD ? 0 : command == CMD_SUB ? 1 : command == CMD_MUL ? 2 : command == CMD_DIV ? 3 : -1;
+}
+
+
+// commands whose target is an instruction index
+static bool has_code_target(unsigned char command) {
+    return is_jump(command) || command == CMD_JZ ||
+           command == CMD_FD || command == CMD_CALL || command == CMD_RET || command == CMD_LEAVE ||
+           command == CMD_TAILCALL;
+}
+
+
+static bool is_push_value(const Instruction& in) {
+    return in.command == CMD_PUSH && in.mode == 0;
+}
+
+
+// number of instructions starting from in that make up a superinstruction (0 if none), fused is filled in
+static size_t match_fused(const Instruction* in, size_t left, Instruction& fused) {
+    fused = {};
+
+    if (left >= 4 && in[0].command == CMD_GET_LOCAL && is_push_value(in[1]) &&
+        arithmetic_index(in[2].command) >= 0 &&
+        in[3].command == CMD_SET_LOCAL && in[3].target == in[0].target) {
+            fused.command = CMD_LOCAL_ADD + arithmetic_index(in[2].command);
+            fused.target = in[0].target;
+            fused.value = in[1].value;
+            return 4;
+    }
+
+    if (left >= 3 && in[0].command == CMD_GET_LOCAL && in[1].command == CMD_GET_LOCAL &&
+        arithmetic_index(in[2].command) >= 0) {
+            fused.command = CMD_GET_LOCALS_ADD + arithmetic_index(in[2].command);
+            fused.target = in[0].target;
+            fused.shift = in[1].target;
+            return 3;
+    }
+
+    if (left >= 2 && is_push_value(in[0]) && arithmetic_index(in[1].command) >= 0) {
+        fused.command = CMD_PUSH_ADD + arithmetic_index(in[1].command);
+        fused.value = in[0].value;
+        return 2;
+    }
+
+    if (left >= 2 && is_push_value(in[0]) && in[0].value == 0 && in[1].command == CMD_JE) {
+        fused.command = CMD_JZ;
+        fused.target = in[1].target;
+        return 2;
+    }
+
+    if (left >= 2 && in[0].command == CMD_SET_LOCAL && in[1].command == CMD_GET_LOCAL &&
+        in[0].target == in[1].target) {
+            fused.command = CMD_TEE_LOCAL;
+            fused.target = in[0].target;
+            return 2;
+    }
+
+    return 0;
+}
+
+
+// returns the instruction of the loaded program every instruction of the fused one starts with
+static std::vector<size_t> fuse(std::vector<Instruction>& code) {
+    const size_t n = code.size();
+
+    // a sequence can't be fused if control may enter it anywhere but at its first instruction
+    std::vector<bool> entry(n + 1, false);
+    for (size_t i = 0; i < n; ++i) {
+        if (has_code_target(code[i].command))
+            entry[code[i].target] = true;
+        if (code[i].command == CMD_CALL)
+            entry[i + 1] = true;
+    }
+
+    std::vector<Instruction> fused_code;
+    std::vector<int> new_index(n + 1);
+    std::vector<size_t> origin;
+
+    for (size_t i = 0; i < n; ) {
+        Instruction fused = {};
+        size_t length = match_fused(&code[i], n - i, fused);
+        for (size_t j = 1; j < length; ++j)
+            if (entry[i + j])
+                length = 0;
+
+        if (length < 2) {
+            fused = code[i];
+            length = 1;
+        }
+
+        for (size_t j = 0; j < length; ++j)
+            new_index[i + j] = fused_code.size();
+        fused_code.push_back(fused);
+        origin.push_back(i);
+        i += length;
+    }
+    new_index[n] = fused_code.size();
+
+    for (auto& in : fused_code)
+        if (has_code_target(in.command))
+            in.target = new_index[in.target];
+
+    code.swap(fused_code);
+    return origin;
+}
@@ -0,0 +1,550 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <memory>
+#include <type_traits>
+#include <stdint.h>
+#include <math.h>
+#include "../stack/stack.h"
+#include "cached_stack.h"
+#include "checked_stack.h"
+#include "unchecked_stack.h"
+#include "processor.h"
+#include "io.h"
+#include "ram.h"
+#include "vector.h"
+#include "verificator.h"
+#include "decoder.h"
+#include "fuser.h"
+#include "translator.h"
+#include "jit.h"
+#include "profiler.h"
+
+
+// Embeddable interpreter: a Processor owns everything a running program touches (registers, RAM, stacks,
+// I/O), so any number of them can run side by side, each on its own thread. load() verifies and prepares
+// a program, run() executes up to budget instructions and can be called again to go on from where it
+// stopped, state() tells what happened. ../stack/stack.h has no include guard, include this header once.
+
+
+// computed goto (GCC, Clang) unless the portable switch is asked for with -DPROC_SWITCH_DISPATCH
+#if defined(__GNUC__) && !defined(PROC_SWITCH_DISPATCH)
+    #define PROC_THREADED_DISPATCH
+#endif
+
+
+// number of top stack elements kept out of memory (0..2), -DPROC_TOS_CACHE_SIZE=0 gives the plain stack machine
+#ifndef PROC_TOS_CACHE_SIZE
+    #define PROC_TOS_CACHE_SIZE 2
+#endif
+
+
+enum ProcessorEngine : unsigned char {
+    ENGINE_STACK,
+    ENGINE_REGISTERS,           // translator.h
+    ENGINE_JIT,                 // jit.h, runs to the end whatever the budget
+};
+
+
+enum ProcessorStatus : unsigned char {
+    STATUS_EMPTY,               // nothing is loaded
+    STATUS_READY,               // loaded, not finished yet
+    STATUS_HALTED,
+    STATUS_FAILED,
+};
+
+
+struct ProcessorOptions {
+    ProcessorEngine engine = ENGINE_STACK;
+    bool fuse = true;            // superinstructions (fuser.h) for the stack engine
+    size_t ram_size = 0;         // cells of RAM, 0 - what the bytecode header asks for
+    bool huge_pages = false;     // ask for transparent huge pages for RAM
+    bool profile = false;        // profiler.h, runs the stack engine without superinstructions
+};
+
+
+struct ProcessorState {
+    ProcessorStatus status;
+    ProcessorEngine engine;     // the one actually running, load() falls back when it has to
+    bool proven;                // StackVerifier proved the program, it runs on the unchecked stack
+    size_t executed;            // instructions so far (not counted by the JIT)
+    std::string warning;        // why load() fell back to another engine
+    std::string error;          // STATUS_FAILED: what went wrong
+    std::array<double, __REGISTERS_NUMBER__> registers;
+    const double* RAM;          // ram_size values, valid until the next load()
+    size_t ram_size;
+};
+
+
+// address of a PUSH or POP [reg+shift] the verifier could not bound, base is the value of reg (0 without
+// one); the index is trunc(base) + shift, so a NaN or infinite base is out of range as well
+static size_t check_ram_index(double base, int shift, size_t ram_size, size_t instruction) {
+    const double index = trunc(base) + shift;
+    if (!(index >= 0 && index < (double)ram_size))
+        throw runtime_exception(instruction, get_string("RAM index %.17lg is out of range (RAM size = %zu)",
+                                                        index, ram_size));
+    return (size_t)index;
+}
+
+
+#define CONCAT_(a, b) a##b
+#define CONCAT(a, b) CONCAT_(a, b)
+
+// every handler is generated once per cache depth (TOS_STATE), which is known to it at compile time
+#define LABEL(cmd) CONCAT(label_##cmd##_, TOS_STATE)
+
+
+class Processor {
+public:
+    explicit Processor(ProcessorOptions options = ProcessorOptions(), ProcessorIO io = ProcessorIO())
+        : options_(options), io_(std::move(io)) {}
+
+    Processor(const Processor&) = delete;
+    Processor& operator=(const Processor&) = delete;
+
+    // throws verificator_exception, std::system_error if RAM cannot be mapped;
+    // the bytes are not needed after it returns
+    void load(const char* bytes, size_t size) {
+        status_ = STATUS_EMPTY;
+        engine_ = options_.engine;
+        executed_ = 0;
+        warning_.clear();
+        error_.clear();
+        registers_.fill(0);
+        checked_.reset();
+        unchecked_.reset();
+        register_machine_.reset();
+        profiler_.reset();
+#ifdef PROC_JIT
+        jit_.reset();
+#endif
+
+        verify(bytes, size, options_.ram_size);
+        const size_t ram_size = options_.ram_size ? options_.ram_size : header_ram_size(bytes);
+        RAM_.map(ram_size, options_.huge_pages);
+
+        program_ = decode(bytes, size);
+        fused_origin_.clear();
+        analysis_ = StackVerifier(program_, ram_size).analyze();
+
+        if (options_.profile) {
+            if (engine_ != ENGINE_STACK)
+                warning_ = "the profiler runs on the stack engine";
+            engine_ = ENGINE_STACK;
+            profiler_.reset(new Profiler(program_, instruction_offsets(bytes, size)));
+        }
+
+        if (engine_ != ENGINE_STACK) {
+            try {
+                translated_ = RegisterTranslator(program_, analysis_).translate();
+            } catch (translator_exception& e) {
+                warning_ = get_string("instruction %zu: %s, running on the stack engine", e.instruction, e.what());
+                engine_ = ENGINE_STACK;
+            }
+        }
+
+        if (engine_ == ENGINE_JIT) {
+#ifdef PROC_JIT
+            jit_.reset(new Jit(translated_, ram_size));
+            try {
+                jit_->compile();
+            } catch (std::system_error& e) {
+                warning_ = get_string("jit: %s, interpreting", e.what());
+                jit_.reset();
+                engine_ = ENGINE_REGISTERS;
+            }
+#else
+            warning_ = "no jit for this platform, interpreting";
+            engine_ = ENGINE_REGISTERS;
+#endif
+        }
+
+        if (engine_ == ENGINE_REGISTERS) {
+            register_machine_.reset(new RegisterMachine());
+            register_machine_->file.resize(std::max<size_t>(translated_.size, 1));
+        } else if (engine_ == ENGINE_STACK) {
+            if (options_.fuse && !profiler_)
+                fused_origin_ = fuse(program_);
+            if (analysis_.proven)
+                unchecked_.reset(new StackMachine<UncheckedStack>());
+            else
+                checked_.reset(new StackMachine<CheckedStack>());
+        }
+
+        status_ = STATUS_READY;
+    }
+
+    // executes at most budget instructions
+    ProcessorStatus run(size_t budget = SIZE_MAX) {
+        if (status_ != STATUS_READY)
+            return status_;
+
+        try {
+            bool halted = true;
+            if (engine_ == ENGINE_JIT)
+                run_jit_();
+            else if (engine_ == ENGINE_REGISTERS)
+                halted = run_registers_(budget);
+            else if (unchecked_)
+                halted = profiler_ ? run_stack_<true>(*unchecked_, budget) : run_stack_<false>(*unchecked_, budget);
+            else
+                halted = profiler_ ? run_stack_<true>(*checked_, budget) : run_stack_<false>(*checked_, budget);
+
+            if (halted)
+                status_ = STATUS_HALTED;
+        } catch (runtime_exception& e) {
+            if (profiler_)
+                profiler_->pause(SIZE_MAX);
+            if (e.instruction != SIZE_MAX && engine_ == ENGINE_STACK && !fused_origin_.empty())
+                e.instruction = fused_origin_[e.instruction];
+            error_ = e.instruction == SIZE_MAX ? e.what() : get_string("instruction %zu: %s", e.instruction, e.what());
+            status_ = STATUS_FAILED;
+        }
+
+        if (io_.flush)
+            io_.flush();
+        return status_;
+    }
+
+    ProcessorState state() const {
+        return {status_, engine_, analysis_.proven, executed_, warning_, error_, registers_, RAM_.data(), RAM_.size()};
+    }
+
+    // nullptr unless ProcessorOptions::profile
+    const Profiler* profiler() const {
+        return profiler_.get();
+    }
+
+private:
+    // what CALL saves: where to return and the frame pointer of the caller
+    struct StackFrame {
+        size_t ip;
+        size_t fp;
+
+        // Stack dumps its elements with this when it finds itself broken
+        void dump(FILE* file) const {
+            fprintf(file, "StackFrame {ip = %zu, fp = %zu}", ip, fp);
+        }
+    };
+
+    // Memory is CheckedStack or, for programs StackVerifier proved, UncheckedStack
+    template <template <typename> class Memory>
+    struct StackMachine {
+        Memory<double> memory;
+        CachedStack<double, PROC_TOS_CACHE_SIZE, Memory<double>> stack{memory};
+        Memory<StackFrame> call_stack;
+        size_t fp = 0;          // index of the first local of the current function, its arguments are below
+        size_t ip = 0;
+
+        // per cache depth: one handler address per instruction, the extra one is for falling off the end
+        std::vector<const void*> threaded[PROC_TOS_CACHE_SIZE + 1];
+    };
+
+    struct RegisterMachine {
+        struct Call {
+            size_t ip;
+            size_t fp;
+        };
+
+        std::vector<double> file;
+        std::vector<Call> calls;
+        size_t fp = 0;
+        size_t ip = 0;
+        std::vector<const void*> threaded;
+    };
+
+    const ProcessorOptions options_;
+    ProcessorIO io_;
+
+    ProcessorStatus status_ = STATUS_EMPTY;
+    ProcessorEngine engine_ = ENGINE_STACK;
+    size_t executed_ = 0;
+    std::string warning_;
+    std::string error_;
+
+    std::array<double, __REGISTERS_NUMBER__> registers_ = {};
+    LazyRAM RAM_;
+
+    std::vector<Instruction> program_;
+    std::vector<size_t> fused_origin_;      // instruction of the loaded program per fused one, empty - not fused
+    StackAnalysis analysis_;
+    RegisterProgram translated_;
+
+    std::unique_ptr<StackMachine<CheckedStack>> checked_;
+    std::unique_ptr<StackMachine<UncheckedStack>> unchecked_;
+    std::unique_ptr<RegisterMachine> register_machine_;
+    std::unique_ptr<Profiler> profiler_;
+#ifdef PROC_JIT
+    std::unique_ptr<Jit> jit_;
+#endif
+
+
+    // the last instruction the budget allows, SIZE_MAX - no limit
+    size_t limit_(size_t budget) const {
+        return budget < SIZE_MAX - executed_ ? executed_ + budget : SIZE_MAX;
+    }
+
+    // true if the program halted, false if the budget ran out; without PROFILE there is no trace of the profiler
+    template <bool PROFILE, template <typename> class Memory>
+    bool run_stack_(StackMachine<Memory>& machine, size_t budget) {
+        const std::vector<Instruction>& program = program_;
+        auto& stack = machine.stack;
+        auto& call_stack = machine.call_stack;
+        auto& registers = registers_;
+        auto& RAM = RAM_;
+        auto& io = io_;
+        Profiler* profiler = profiler_.get();
+        (void)profiler;
+
+        const size_t limit = limit_(budget);
+        size_t executed = executed_;
+        size_t ip = machine.ip;
+        size_t fp = machine.fp;
+        bool halted = false;
+        if constexpr (std::is_same<Memory<double>, CheckedStack<double>>::value)
+            machine.memory.ip = machine.call_stack.ip = &ip;
+
+#define HALT() goto halt
+
+#ifdef PROC_THREADED_DISPATCH
+        static const void* const labels[PROC_TOS_CACHE_SIZE + 1][__ALL_COMMANDS_NUMBER__] = {
+
+#define DEF_CMD(cmd, args_number, code) &&LABEL(cmd),
+#define DEF_FUSED(cmd, code) &&LABEL(cmd),
+#define TOS_STATE 0
+            {
+#include "commands.h"
+            },
+#undef TOS_STATE
+#if PROC_TOS_CACHE_SIZE >= 1
+#define TOS_STATE 1
+            {
+#include "commands.h"
+            },
+#undef TOS_STATE
+#endif
+#if PROC_TOS_CACHE_SIZE >= 2
+#define TOS_STATE 2
+            {
+#include "commands.h"
+            },
+#undef TOS_STATE
+#endif
+#undef DEF_FUSED
+#undef DEF_CMD
+
+        };
+
+        auto& threaded = machine.threaded;
+        if (threaded[0].empty())
+            for (size_t state = 0; state <= PROC_TOS_CACHE_SIZE; ++state) {
+                threaded[state].assign(program.size() + 1, &&halt);
+                for (size_t i = 0; i < program.size(); ++i)
+                    threaded[state][i] = labels[state][program[i].command];
+            }
+
+#define DISPATCH() \
+    do { \
+        if (executed == limit) \
+            goto suspend; \
+        goto *threaded[stack.depth][ip]; \
+    } while (0)
+
+        DISPATCH();
+
+#define DEF_CMD(cmd, args_number, code) \
+    LABEL(cmd): { \
+        if constexpr (PROFILE) \
+            profiler->step(ip); \
+        const Instruction& in = program[ip]; \
+        (void)in; \
+        stack.depth = TOS_STATE; \
+        ++ip; \
+        ++executed; \
+        code; \
+    } \
+    DISPATCH();
+#define DEF_FUSED(cmd, code) DEF_CMD(cmd, 0, code)
+#define TOS_STATE 0
+#include "commands.h"
+#undef TOS_STATE
+#if PROC_TOS_CACHE_SIZE >= 1
+#define TOS_STATE 1
+#include "commands.h"
+#undef TOS_STATE
+#endif
+#if PROC_TOS_CACHE_SIZE >= 2
+#define TOS_STATE 2
+#include "commands.h"
+#undef TOS_STATE
+#endif
+#undef DEF_FUSED
+#undef DEF_CMD
+
+#undef DISPATCH
+
+#else
+        while (executed != limit) {
+            if (ip == program.size())
+                goto halt;
+
+            if constexpr (PROFILE)
+                profiler->step(ip);
+
+            const Instruction& in = program[ip];
+            ++ip;
+            ++executed;
+            switch (stack.depth * __ALL_COMMANDS_NUMBER__ + in.command) {
+
+#define DEF_CMD(cmd, args_number, code) \
+                case TOS_STATE * __ALL_COMMANDS_NUMBER__ + CMD_##cmd: \
+                    stack.depth = TOS_STATE; \
+                    code; \
+                    break;
+#define DEF_FUSED(cmd, code) DEF_CMD(cmd, 0, code)
+#define TOS_STATE 0
+#include "commands.h"
+#undef TOS_STATE
+#if PROC_TOS_CACHE_SIZE >= 1
+#define TOS_STATE 1
+#include "commands.h"
+#undef TOS_STATE
+#endif
+#if PROC_TOS_CACHE_SIZE >= 2
+#define TOS_STATE 2
+#include "commands.h"
+#undef TOS_STATE
+#endif
+#undef DEF_FUSED
+#undef DEF_CMD
+
+                default: __builtin_unreachable();
+            }
+        }
+        goto suspend;
+#endif
+
+        halt:
+        halted = true;
+
+        suspend:
+        if constexpr (PROFILE)
+            profiler->pause(ip);
+        machine.ip = ip;
+        machine.fp = fp;
+        executed_ = executed;
+        return halted;
+
+#undef HALT
+    }
+
+    // true if the program halted, false if the budget ran out
+    bool run_registers_(size_t budget) {
+        RegisterMachine& machine = *register_machine_;
+        const std::vector<RegisterInstruction>& instructions = translated_.code;
+        auto& file = machine.file;
+        auto& calls = machine.calls;
+        auto& registers = registers_;
+        auto& RAM = RAM_;
+        auto& io = io_;
+
+        const size_t limit = limit_(budget);
+        size_t executed = executed_;
+        size_t ip = machine.ip;
+        size_t fp = machine.fp;
+        double* frame = file.data() + fp;
+        bool halted = false;
+
+#define HALT() goto halt
+
+#ifdef PROC_THREADED_DISPATCH
+        static const void* const labels[] = {
+
+#define DEF_ROP(cmd, code) &&register_label_##cmd,
+#include "register_commands.h"
+#undef DEF_ROP
+
+        };
+
+        auto& threaded = machine.threaded;
+        if (threaded.empty()) {
+            threaded.resize(instructions.size());
+            for (size_t i = 0; i < instructions.size(); ++i)
+                threaded[i] = labels[instructions[i].command];
+        }
+
+#define DISPATCH() \
+    do { \
+        if (executed == limit) \
+            goto suspend; \
+        goto *threaded[ip]; \
+    } while (0)
+
+        DISPATCH();
+
+#define DEF_ROP(cmd, code) \
+    register_label_##cmd: { \
+        const RegisterInstruction& in = instructions[ip]; \
+        (void)in; \
+        ++ip; \
+        ++executed; \
+        code; \
+    } \
+    DISPATCH();
+#include "register_commands.h"
+#undef DEF_ROP
+
+#undef DISPATCH
+
+#else
+        while (executed != limit) {
+            const RegisterInstruction& in = instructions[ip];
+            ++ip;
+            ++executed;
+            switch (in.command) {
+
+#define DEF_ROP(cmd, code) \
+                case RCMD_##cmd: \
+                    code; \
+                    break;
+#include "register_commands.h"
+#undef DEF_ROP
+
+                default: __builtin_unreachable();
+            }
+        }
+        goto suspend;
+#endif
+
+        halt:
+        halted = true;
+
+        suspend:
+        machine.ip = ip;
+        machine.fp = fp;
+        executed_ = executed;
+        return halted;
+
+#undef HALT
+    }
+
+    void run_jit_() {
+#ifdef PROC_JIT
+        // the generated code keeps no instruction index
+        const bool finished = jit_->run(RAM_.data(), registers_.data(), io_);
+        if (jit_->out_of_ram() != SIZE_MAX) {
+            const RegisterInstruction& in = translated_.code[jit_->out_of_ram()];
+            check_ram_index(in.reg ? registers_[in.reg - 1] : 0, in.shift, RAM_.size(), in.origin);
+        }
+        if (!finished)
+            throw runtime_exception(SIZE_MAX, "call stack overflow");
+#endif
+    }
+};
+
+
+#undef LABEL
+#undef CONCAT
+#undef CONCAT_
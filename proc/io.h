@@ -0,0 +1,259 @@
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <charconv>
+#include <string>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <unistd.h>
+#include <errno.h>
+#include "bmpwriter.h"
+
+
+// how IN and OUT see the console
+enum IOFormat : unsigned char {
+    IO_FIXED,                   // text, OUT prints like printf("%lf\n")
+    IO_SHORTEST,                // text, OUT prints the shortest text that reads back as the same double
+    IO_BINARY,                  // raw little-endian doubles both ways
+};
+
+
+// Writes through a buffer of its own, the FILE sees one fwrite per BUFFER_SIZE bytes.
+class BufferedWriter {
+public:
+    static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+    explicit BufferedWriter(FILE* out) : out_(out), buffer_(BUFFER_SIZE) {}
+
+    ~BufferedWriter() {
+        flush();
+    }
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    void write(double a, IOFormat format) {
+        // %lf of the largest double is 316 characters
+        if (BUFFER_SIZE - size_ < 512)
+            flush();
+
+        char* first = buffer_.data() + size_;
+        char* last = buffer_.data() + BUFFER_SIZE;
+        if (format == IO_BINARY) {
+            store_little_endian_(first, a);
+            size_ += sizeof(a);
+            return;
+        }
+
+        auto result = format == IO_FIXED ? std::to_chars(first, last, a, std::chars_format::fixed, 6)
+                                         : std::to_chars(first, last, a);
+        *result.ptr = '\n';
+        size_ = result.ptr + 1 - buffer_.data();
+    }
+
+    void flush() {
+        if (size_)
+            fwrite(buffer_.data(), 1, size_, out_);
+        size_ = 0;
+        fflush(out_);
+    }
+
+private:
+    FILE* out_;
+    std::vector<char> buffer_;
+    size_t size_ = 0;
+
+    static void store_little_endian_(char* where, double a) {
+        unsigned char bytes[sizeof(a)];
+        memcpy(bytes, &a, sizeof(a));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        std::reverse(bytes, bytes + sizeof(a));
+#endif
+        memcpy(where, bytes, sizeof(a));
+    }
+};
+
+
+// Reads through a buffer of its own and parses numbers with std::from_chars. Text input follows
+// scanf("%lf"): whitespace is skipped, a number that cannot be read gives 0 and stays where it is.
+// Before it waits for more input it flushes the writer it is tied to, so prompts show up.
+class BufferedReader {
+public:
+    static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+    BufferedReader(FILE* in, BufferedWriter* tied) : in_(in), tied_(tied), buffer_(BUFFER_SIZE) {}
+
+    BufferedReader(const BufferedReader&) = delete;
+    BufferedReader& operator=(const BufferedReader&) = delete;
+
+    double read(IOFormat format) {
+        return format == IO_BINARY ? read_binary_() : read_text_();
+    }
+
+private:
+    FILE* in_;
+    BufferedWriter* tied_;
+    std::vector<char> buffer_;
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    bool eof_ = false;
+
+    // moves what is left to the front and reads more after it, false if nothing came
+    bool fill_() {
+        if (eof_)
+            return false;
+        if (tied_)
+            tied_->flush();
+
+        memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+        if (end_ == buffer_.size())
+            buffer_.resize(2 * buffer_.size());
+
+        // read() returns what is there, fread would wait for the whole buffer on a terminal
+        ssize_t n = 0;
+        do
+            n = ::read(fileno(in_), buffer_.data() + end_, buffer_.size() - end_);
+        while (n == -1 && errno == EINTR);
+
+        eof_ = n <= 0;
+        if (eof_)
+            return false;
+        end_ += n;
+        return true;
+    }
+
+    double read_binary_() {
+        while (end_ - begin_ < sizeof(double))
+            if (!fill_())
+                return 0;
+
+        unsigned char bytes[sizeof(double)];
+        memcpy(bytes, buffer_.data() + begin_, sizeof(bytes));
+        begin_ += sizeof(bytes);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        std::reverse(bytes, bytes + sizeof(bytes));
+#endif
+        double a = 0;
+        memcpy(&a, bytes, sizeof(a));
+        return a;
+    }
+
+    // how much of a token that is not a number scanf reads anyway: the sign and 0x before number, then a
+    // point or the part of inf or nan the token starts with; the next read goes on after it
+    static size_t rejected_(const char* first, const char* number, const char* last) {
+        if (number != last && *number == '.')
+            return number + 1 - first;
+        for (const char* word : {"infinity", "nan"}) {
+            const char* p = number;
+            while (p != last && *word && tolower((unsigned char)*p) == *word) {
+                ++p;
+                ++word;
+            }
+            if (p != number)
+                return p - first;
+        }
+        return number - first;
+    }
+
+    double read_text_() {
+        while (true) {
+            while (begin_ != end_ && isspace((unsigned char)buffer_[begin_]))
+                ++begin_;
+            if (begin_ != end_)
+                break;
+            if (!fill_())
+                return 0;
+        }
+
+        // the whole token has to be in the buffer
+        size_t last = begin_;
+        while (true) {
+            while (last != end_ && !isspace((unsigned char)buffer_[last]))
+                ++last;
+            if (last != end_)
+                break;
+
+            const size_t offset = last - begin_;
+            if (!fill_())
+                break;
+            last = begin_ + offset;
+        }
+
+        const char* first = buffer_.data() + begin_;
+        const char* token_end = buffer_.data() + last;
+        const char* number = first;
+
+        bool negative = false;
+        if (number != token_end && (*number == '+' || *number == '-')) {
+            negative = *number == '-';
+            ++number;
+        }
+
+        std::chars_format format = std::chars_format::general;
+        if (token_end - number >= 2 && number[0] == '0' && (number[1] == 'x' || number[1] == 'X')) {
+            format = std::chars_format::hex;
+            number += 2;
+        }
+
+        double a = 0;
+        auto result = std::from_chars(number, token_end, a, format);
+        if (number == token_end || result.ec == std::errc::invalid_argument || *number == '-' || *number == '+') {
+            begin_ += rejected_(first, number, token_end);
+            return 0;
+        }
+        // scanf also eats an exponent without digits, as in 1.5e
+        const char* tail = result.ptr;
+        const char exponent = format == std::chars_format::hex ? 'p' : 'e';
+        if (tail != token_end && tolower((unsigned char)*tail) == exponent) {
+            ++tail;
+            if (tail != token_end && (*tail == '+' || *tail == '-'))
+                ++tail;
+            if (tail == token_end || !isdigit((unsigned char)*tail))
+                result.ptr = tail;
+        }
+
+        begin_ += result.ptr - first;
+        // scanf gives inf or 0 for what does not fit a double, from_chars only says it does not fit
+        if (result.ec == std::errc::result_out_of_range)
+            return strtod(std::string(first, result.ptr).c_str(), nullptr);
+        return negative ? -a : a;
+    }
+};
+
+
+// IN, OUT and DRAW of a running program go through these. The default is the console through the
+// buffers above, flush is called when Processor::run returns.
+struct ProcessorIO {
+    std::function<double()> read;
+    std::function<void(double)> write;
+    std::function<void(int, int, const double*, const double*)> draw;
+    std::function<void()> flush;
+
+    explicit ProcessorIO(IOFormat format = IO_FIXED) {
+        auto writer = std::make_shared<BufferedWriter>(stdout);
+        auto reader = std::make_shared<BufferedReader>(stdin, writer.get());
+
+        read = [reader, writer, format]() {
+            return reader->read(format);
+        };
+
+        write = [writer, format](double a) {
+            writer->write(a, format);
+        };
+
+        draw = [](int width, int height, const double* first, const double* last) {
+            fwritebmp(fopen("proc_picture.bmp", "w"), width, height, first, last);
+        };
+
+        flush = [writer]() {
+            writer->flush();
+        };
+    }
+};
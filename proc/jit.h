@@ -0,0 +1,619 @@
+#pragma once
+
+#include <vector>
+#include <initializer_list>
+#include <system_error>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "processor.h"
+#include "translator.h"
+#include "io.h"
+#include "vector.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+    #define PROC_JIT
+    #include <sys/mman.h>
+#endif
+
+
+// Baseline template JIT: every instruction of the register program (translator.h) becomes a fixed
+// sequence of x86-64 code. Frame registers stay in the register file, rbx points to the current frame
+// and values pass through xmm0..xmm3. CALL and RET are native calls, so a function of the program is a
+// native function with its frame pointer saved on the machine stack; TAILCALL moves rbx and jumps. The
+// generated code runs on a machine stack of its own, big enough for a call per cell of the register file.
+// IN, OUT and DRAW call the helpers below, the math functions are called from libm like the interpreter
+// does. A call stack overflow (of the register file or of the machine stack) returns from the generated
+// code like HALT does.
+//
+// Registers:  rbx - frame, r12 - rsp to return to on HALT, r13 - RAM, r14 - registers, r15 - end of the file
+
+#ifdef PROC_JIT
+
+// what the helpers work with, Jit::run sets it for its thread
+struct JitContext {
+    ProcessorIO* io;
+    double* RAM;
+    bool overflow;
+    size_t out_of_ram;          // GETM or SETM whose address is not in RAM, SIZE_MAX - none
+};
+
+static thread_local JitContext jit_context;
+
+
+static double jit_read() {
+    return jit_context.io->read();
+}
+
+static void jit_write(double a) {
+    jit_context.io->write(a);
+}
+
+static void jit_draw(int width, int height, int ndata) {
+    jit_context.io->draw(width, height, jit_context.RAM, jit_context.RAM + ndata);
+}
+
+static void jit_overflow() {
+    jit_context.overflow = true;
+}
+
+static void jit_out_of_ram(size_t instruction) {
+    jit_context.out_of_ram = instruction;
+}
+
+
+class Jit {
+public:
+    // frames of the program are placed in a reserved region of FILE_SIZE doubles
+    static constexpr size_t FILE_SIZE = (size_t)1 << 24;
+    // a CALL pushes rbx and the return address, the bottom STACK_RESERVE bytes are left to the helpers
+    static constexpr size_t STACK_RESERVE = (size_t)1 << 20;
+    static constexpr size_t STACK_SIZE = FILE_SIZE * 16 + STACK_RESERVE;
+
+    Jit(const RegisterProgram& program, size_t ram_size) : program_(program), ram_size_(ram_size) {}
+
+    ~Jit() {
+        if (code_)
+            munmap(code_, code_size_);
+        if (file_)
+            munmap(file_, FILE_SIZE * sizeof(double));
+        if (stack_)
+            munmap(stack_, STACK_SIZE);
+    }
+
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    void compile() {
+        stack_ = (unsigned char*)map_(STACK_SIZE);
+        emit_prologue_();
+
+        labels_.resize(program_.code.size());
+        for (size_t i = 0; i < program_.code.size(); ++i) {
+            labels_[i] = out_.size();
+            emit_(program_.code[i]);
+        }
+
+        overflow_ = out_.size();
+        call_(reinterpret_cast<void*>(jit_overflow));
+        emit_halt_();
+
+        // edi = the instruction; mov rsp, r12 (the helper may need the alignment)
+        out_of_ram_ = out_.size();
+        bytes_({0x4C, 0x89, 0xE4});
+        call_(reinterpret_cast<void*>(jit_out_of_ram));
+        emit_halt_();
+
+        for (auto& patch : patches_) {
+            const size_t target = patch.second == __OVERFLOW__ ? overflow_ :
+                                  patch.second == __OUT_OF_RAM__ ? out_of_ram_ : labels_[patch.second];
+            const int32_t rel = (int32_t)(target - (patch.first + sizeof(int32_t)));
+            memcpy(out_.data() + patch.first, &rel, sizeof(rel));
+        }
+
+        code_size_ = out_.size();
+        code_ = (unsigned char*)map_(code_size_);
+        memcpy(code_, out_.data(), code_size_);
+        if (mprotect(code_, code_size_, PROT_READ | PROT_EXEC))
+            throw std::system_error(errno, std::generic_category(), "mprotect");
+
+        file_ = (double*)map_(FILE_SIZE * sizeof(double));
+    }
+
+    // false if the program ran out of the frames region
+    bool run(double* RAM, double* registers, ProcessorIO& io) {
+        jit_context = {&io, RAM, false, SIZE_MAX};
+        auto entry = reinterpret_cast<void (*)(double*, double*, double*, double*, unsigned char*)>(code_);
+        entry(file_, file_ + FILE_SIZE, RAM, registers, stack_ + STACK_SIZE);
+        out_of_ram_instruction_ = jit_context.out_of_ram;
+        return !jit_context.overflow;
+    }
+
+    // the GETM or SETM the last run() stopped at because its address is not in RAM, SIZE_MAX - none
+    size_t out_of_ram() const {
+        return out_of_ram_instruction_;
+    }
+
+private:
+    static constexpr size_t __OVERFLOW__ = SIZE_MAX;
+    static constexpr size_t __OUT_OF_RAM__ = SIZE_MAX - 1;
+
+    enum : unsigned char { XMM0, XMM1, XMM2, XMM3 };
+
+    // condition codes of jcc and setcc
+    enum : unsigned char { CC_B = 0x2, CC_AE = 0x3, CC_BE = 0x6, CC_A = 0x7 };
+
+    // integer argument registers of the SysV ABI
+    enum : unsigned char { RCX = 1, RDX = 2, RSI = 6, RDI = 7 };
+
+    const RegisterProgram& program_;
+    const size_t ram_size_;
+    std::vector<unsigned char> out_;
+    std::vector<size_t> labels_;
+    std::vector<std::pair<size_t, size_t>> patches_;     // rel32 position, instruction index
+    size_t overflow_ = 0;
+    size_t out_of_ram_ = 0;
+    size_t out_of_ram_instruction_ = SIZE_MAX;
+
+    unsigned char* code_ = nullptr;
+    size_t code_size_ = 0;
+    double* file_ = nullptr;
+    unsigned char* stack_ = nullptr;
+
+
+    static void* map_(size_t size) {
+        void* where = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (where == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), "mmap");
+        return where;
+    }
+
+    void bytes_(std::initializer_list<unsigned char> bytes) {
+        out_.insert(out_.end(), bytes);
+    }
+
+    void int32_(int32_t value) {
+        const unsigned char* bytes = (const unsigned char*)&value;
+        out_.insert(out_.end(), bytes, bytes + sizeof(value));
+    }
+
+    void int64_(uint64_t value) {
+        const unsigned char* bytes = (const unsigned char*)&value;
+        out_.insert(out_.end(), bytes, bytes + sizeof(value));
+    }
+
+    // rel32 to be filled in with the address of the instruction
+    void rel32_(size_t instruction) {
+        patches_.push_back({out_.size(), instruction});
+        int32_(0);
+    }
+
+    // movsd xmm, [rbx + 8 * reg]
+    void load_(unsigned char xmm, int reg) {
+        bytes_({0xF2, 0x0F, 0x10, (unsigned char)(0x80 | xmm << 3 | 3)});
+        int32_(8 * reg);
+    }
+
+    // movsd [rbx + 8 * reg], xmm
+    void store_(int reg, unsigned char xmm) {
+        bytes_({0xF2, 0x0F, 0x11, (unsigned char)(0x80 | xmm << 3 | 3)});
+        int32_(8 * reg);
+    }
+
+    // mov rax, value; movq xmm, rax
+    void load_constant_(unsigned char xmm, double value) {
+        uint64_t bits = 0;
+        memcpy(&bits, &value, sizeof(bits));
+        bytes_({0x48, 0xB8});
+        int64_(bits);
+        bytes_({0x66, 0x48, 0x0F, 0x6E, (unsigned char)(0xC0 | xmm << 3)});
+    }
+
+    // addsd (0x58), mulsd (0x59), subsd (0x5C), divsd (0x5E) dst, src
+    void arithmetic_(unsigned char opcode, unsigned char dst, unsigned char src) {
+        bytes_({0xF2, 0x0F, opcode, (unsigned char)(0xC0 | dst << 3 | src)});
+    }
+
+    // flags of x - y
+    void comisd_(unsigned char x, unsigned char y) {
+        bytes_({0x66, 0x0F, 0x2F, (unsigned char)(0xC0 | x << 3 | y)});
+    }
+
+    void call_(void* function) {
+        bytes_({0x48, 0xB8});
+        int64_((uint64_t)function);
+        bytes_({0xFF, 0xD0});
+    }
+
+    // sign bit of xmm0: btr (0xF0) clears it, btc (0xF8) flips it
+    void sign_(unsigned char operation) {
+        bytes_({0x66, 0x48, 0x0F, 0x7E, 0xC0});
+        bytes_({0x48, 0x0F, 0xBA, operation, 0x3F});
+        bytes_({0x66, 0x48, 0x0F, 0x6E, 0xC0});
+    }
+
+    // rax = RAM address of GETM, SETM
+    void ram_address_(const RegisterInstruction& in) {
+        if (in.reg) {
+            // cvttsd2si rax, [r14 + 8 * (reg - 1)]
+            bytes_({0xF2, 0x49, 0x0F, 0x2C, 0x86});
+            int32_(8 * (in.reg - 1));
+            bytes_({0x48, 0x05});
+            int32_(in.shift);
+        } else {
+            bytes_({0x48, 0xC7, 0xC0});
+            int32_(in.shift);
+        }
+    }
+
+    // GETM, SETM the verifier could not bound: leave through out_of_ram_ unless rax < ram_size. A negative,
+    // NaN or too big base converts to an rax that is at least 2^63 unsigned, check_ram_index fails it too.
+    void ram_check_(const RegisterInstruction& in) {
+        // mov rcx, ram_size; cmp rax, rcx; jb over the exit
+        bytes_({0x48, 0xB9});
+        int64_(ram_size_);
+        bytes_({0x48, 0x39, 0xC8, 0x72, 0x0A});
+        // mov edi, instruction; jmp out_of_ram_
+        bytes_({0xBF});
+        int32_(&in - program_.code.data());
+        bytes_({0xE9});
+        rel32_(__OUT_OF_RAM__);
+    }
+
+    // argument = RAM + cell
+    void ram_pointer_(unsigned char argument, int cell) {
+        // mov eax, cell; lea argument, [r13 + 8 * rax]
+        bytes_({0xB8});
+        int32_(cell);
+        bytes_({0x49, 0x8D, (unsigned char)(0x44 | argument << 3), 0xC5, 0x00});
+    }
+
+    // mov argument32, n (the upper half is zeroed)
+    void count_(unsigned char argument, int n) {
+        bytes_({(unsigned char)(0xB8 + argument)});
+        int32_(n);
+    }
+
+    void emit_prologue_() {
+        // push rbx, r12, r13, r14, r15 (rsp is aligned to 16 after them)
+        bytes_({0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57});
+        // mov rbx, rdi; mov r15, rsi; mov r13, rdx; mov r14, rcx; mov r12, rsp; mov rsp, r8
+        bytes_({0x48, 0x89, 0xFB, 0x49, 0x89, 0xF7, 0x49, 0x89, 0xD5, 0x49, 0x89, 0xCE, 0x49, 0x89, 0xE4});
+        bytes_({0x4C, 0x89, 0xC4});
+    }
+
+    void emit_halt_() {
+        // mov rsp, r12; pop r15, r14, r13, r12, rbx; ret
+        bytes_({0x4C, 0x89, 0xE4, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3});
+    }
+
+    // b goes to xmm0, a to xmm1
+    void binary_operands_(const RegisterInstruction& in, unsigned char variant) {
+        if (variant == 2)
+            load_constant_(XMM0, in.k);
+        else
+            load_(XMM0, in.b);
+
+        if (variant == 1)
+            load_constant_(XMM1, in.k);
+        else
+            load_(XMM1, in.a);
+    }
+
+    // sets the flags for the comparison of b (xmm0) and a (xmm1), returns the condition code of truth
+    unsigned char compare_(unsigned char relation) {
+        switch (relation) {
+            case RCMD_JA_RR: case RCMD_GT_RR:      // GRT(b, a): a + eps < b
+            case RCMD_JBE_RR: case RCMD_LE_RR:
+                load_constant_(XMM2, 1e-6);
+                arithmetic_(0x58, XMM1, XMM2);
+                comisd_(XMM0, XMM1);
+                return relation == RCMD_JA_RR || relation == RCMD_GT_RR ? CC_A : CC_BE;
+
+            case RCMD_JB_RR: case RCMD_LT_RR:      // LESS(b, a): b + eps < a
+            case RCMD_JAE_RR: case RCMD_GE_RR:
+                load_constant_(XMM2, 1e-6);
+                arithmetic_(0x58, XMM0, XMM2);
+                comisd_(XMM1, XMM0);
+                return relation == RCMD_JB_RR || relation == RCMD_LT_RR ? CC_A : CC_BE;
+
+            default:                               // _EQUAL(b, a): |b - a| <= eps
+                arithmetic_(0x5C, XMM0, XMM1);
+                sign_(0xF0);
+                load_constant_(XMM1, 1e-6);
+                comisd_(XMM1, XMM0);
+                return relation == RCMD_JE_RR || relation == RCMD_EQ_RR ? CC_AE : CC_B;
+        }
+    }
+
+    // splits a command made by DEF_BINARY or DEF_BRANCH into its _RR command and the variant (0 - RR, 1 - RK, 2 - KR)
+    static bool binary_(unsigned char command, unsigned char& family, unsigned char& variant) {
+        static const unsigned char families[] = {
+            RCMD_ADD_RR, RCMD_SUB_RR, RCMD_MUL_RR, RCMD_DIV_RR, RCMD_MOD_RR, RCMD_POW_RR,
+            RCMD_EQ_RR, RCMD_NE_RR, RCMD_LT_RR, RCMD_LE_RR, RCMD_GT_RR, RCMD_GE_RR,
+            RCMD_JA_RR, RCMD_JAE_RR, RCMD_JB_RR, RCMD_JBE_RR, RCMD_JE_RR, RCMD_JNE_RR
+        };
+
+        for (unsigned char first : families)
+            if (command >= first && command < first + 3) {
+                family = first;
+                variant = command - first;
+                return true;
+            }
+        return false;
+    }
+
+    static void* unary_function_(unsigned char command) {
+        typedef double (*function)(double);
+        switch (command) {
+            case RCMD_SQRT: return reinterpret_cast<void*>((function)sqrt);
+            case RCMD_SIN: return reinterpret_cast<void*>((function)sin);
+            case RCMD_COS: return reinterpret_cast<void*>((function)cos);
+            case RCMD_TG: return reinterpret_cast<void*>((function)tan);
+            case RCMD_ARCSIN: return reinterpret_cast<void*>((function)asin);
+            case RCMD_ARCCOS: return reinterpret_cast<void*>((function)acos);
+            case RCMD_ARCTG: return reinterpret_cast<void*>((function)atan);
+            case RCMD_SH: return reinterpret_cast<void*>((function)sinh);
+            case RCMD_CH: return reinterpret_cast<void*>((function)cosh);
+            case RCMD_TH: return reinterpret_cast<void*>((function)tanh);
+            case RCMD_ARCSH: return reinterpret_cast<void*>((function)asinh);
+            case RCMD_ARCCH: return reinterpret_cast<void*>((function)acosh);
+            case RCMD_ARCTH: return reinterpret_cast<void*>((function)atanh);
+            case RCMD_LOG: return reinterpret_cast<void*>((function)log);
+            case RCMD_EXP: return reinterpret_cast<void*>((function)exp);
+            default: return nullptr;
+        }
+    }
+
+    void emit_binary_(const RegisterInstruction& in, unsigned char family, unsigned char variant) {
+        typedef double (*function)(double, double);
+
+        binary_operands_(in, variant);
+        switch (family) {
+            case RCMD_ADD_RR: arithmetic_(0x58, XMM0, XMM1); break;
+            case RCMD_SUB_RR: arithmetic_(0x5C, XMM0, XMM1); break;
+            case RCMD_MUL_RR: arithmetic_(0x59, XMM0, XMM1); break;
+            case RCMD_DIV_RR: arithmetic_(0x5E, XMM0, XMM1); break;
+            case RCMD_MOD_RR: call_(reinterpret_cast<void*>((function)fmod)); break;
+            case RCMD_POW_RR: call_(reinterpret_cast<void*>((function)pow)); break;
+
+            case RCMD_JA_RR: case RCMD_JAE_RR: case RCMD_JB_RR:
+            case RCMD_JBE_RR: case RCMD_JE_RR: case RCMD_JNE_RR:
+                // jcc rel32
+                bytes_({0x0F, (unsigned char)(0x80 | compare_(family))});
+                rel32_(in.target);
+                return;
+
+            default:
+                // setcc al; movzx eax, al; cvtsi2sd xmm0, eax
+                bytes_({0x0F, (unsigned char)(0x90 | compare_(family)), 0xC0});
+                bytes_({0x0F, 0xB6, 0xC0, 0xF2, 0x0F, 0x2A, 0xC0});
+                break;
+        }
+        store_(in.dst, XMM0);
+    }
+
+    void emit_(const RegisterInstruction& in) {
+        unsigned char family = 0, variant = 0;
+        if (binary_(in.command, family, variant)) {
+            emit_binary_(in, family, variant);
+            return;
+        }
+
+        if (void* function = unary_function_(in.command)) {
+            load_(XMM0, in.a);
+            call_(function);
+            store_(in.dst, XMM0);
+            return;
+        }
+
+        switch (in.command) {
+            case RCMD_HALT:
+                emit_halt_();
+                break;
+
+            case RCMD_MOV:
+                load_(XMM0, in.a);
+                store_(in.dst, XMM0);
+                break;
+
+            case RCMD_LOADK:
+                load_constant_(XMM0, in.k);
+                store_(in.dst, XMM0);
+                break;
+
+            case RCMD_GETR:
+                // movsd xmm0, [r14 + 8 * reg]
+                bytes_({0xF2, 0x41, 0x0F, 0x10, 0x86});
+                int32_(8 * in.reg);
+                store_(in.dst, XMM0);
+                break;
+
+            case RCMD_SETR:
+                load_(XMM0, in.a);
+                // movsd [r14 + 8 * reg], xmm0
+                bytes_({0xF2, 0x41, 0x0F, 0x11, 0x86});
+                int32_(8 * in.reg);
+                break;
+
+            case RCMD_GETM:
+                ram_address_(in);
+                if (!in.bounded)
+                    ram_check_(in);
+                // movsd xmm0, [r13 + 8 * rax]
+                bytes_({0xF2, 0x41, 0x0F, 0x10, 0x44, 0xC5, 0x00});
+                store_(in.dst, XMM0);
+                break;
+
+            case RCMD_SETM:
+                ram_address_(in);
+                if (!in.bounded)
+                    ram_check_(in);
+                load_(XMM0, in.a);
+                // movsd [r13 + 8 * rax], xmm0
+                bytes_({0xF2, 0x41, 0x0F, 0x11, 0x44, 0xC5, 0x00});
+                break;
+
+            // ABS(a) is ((a) >= 0 ? (a) : -(a)): -0.0 stays negative and NaN changes its sign, like in C
+            case RCMD_ABS:
+                load_(XMM0, in.a);
+                // xorpd xmm1, xmm1; comisd xmm0, xmm1; jae over the sign flip (15 bytes)
+                bytes_({0x66, 0x0F, 0x57, 0xC9});
+                comisd_(XMM0, XMM1);
+                bytes_({0x73, 15});
+                sign_(0xF8);
+                store_(in.dst, XMM0);
+                break;
+
+            case RCMD_INC:
+            case RCMD_DEC:
+                load_(XMM0, in.a);
+                load_constant_(XMM1, 1);
+                arithmetic_(in.command == RCMD_INC ? 0x58 : 0x5C, XMM0, XMM1);
+                store_(in.dst, XMM0);
+                break;
+
+            case RCMD_SQR:
+                load_(XMM0, in.a);
+                arithmetic_(0x59, XMM0, XMM0);
+                store_(in.dst, XMM0);
+                break;
+
+            case RCMD_IN:
+                call_(reinterpret_cast<void*>(jit_read));
+                store_(in.dst, XMM0);
+                break;
+
+            case RCMD_OUT:
+                load_(XMM0, in.a);
+                call_(reinterpret_cast<void*>(jit_write));
+                break;
+
+            case RCMD_JMP:
+                bytes_({0xE9});
+                rel32_(in.target);
+                break;
+
+            case RCMD_CALL:
+                // mov rax, stack_ + STACK_RESERVE; cmp rsp, rax; jb overflow
+                bytes_({0x48, 0xB8});
+                int64_((uint64_t)(stack_ + STACK_RESERVE));
+                bytes_({0x48, 0x39, 0xC4, 0x0F, 0x82});
+                rel32_(__OVERFLOW__);
+                // push rbx; lea rbx, [rbx + 8 * shift]
+                bytes_({0x53, 0x48, 0x8D, 0x9B});
+                int32_(8 * in.shift);
+                // lea rax, [rbx + 8 * size]; cmp rax, r15; ja overflow
+                bytes_({0x48, 0x8D, 0x83});
+                int32_(8 * in.size);
+                bytes_({0x4C, 0x39, 0xF8, 0x0F, 0x87});
+                rel32_(__OVERFLOW__);
+
+                if (in.nlocals) {
+                    // mov rdi, rbx; mov ecx, nlocals; xor eax, eax; rep stosq
+                    bytes_({0x48, 0x89, 0xDF, 0xB9});
+                    int32_(in.nlocals);
+                    bytes_({0x31, 0xC0, 0xF3, 0x48, 0xAB});
+                }
+
+                // call target; pop rbx
+                bytes_({0xE8});
+                rel32_(in.target);
+                bytes_({0x5B});
+                break;
+
+            case RCMD_TAILCALL:
+                for (int i = 0; i < in.nargs; ++i) {
+                    load_(XMM0, in.a + i);
+                    store_(in.dst + i, XMM0);
+                }
+
+                // lea rbx, [rbx + 8 * shift]
+                bytes_({0x48, 0x8D, 0x9B});
+                int32_(8 * in.shift);
+                // lea rax, [rbx + 8 * size]; cmp rax, r15; ja overflow
+                bytes_({0x48, 0x8D, 0x83});
+                int32_(8 * in.size);
+                bytes_({0x4C, 0x39, 0xF8, 0x0F, 0x87});
+                rel32_(__OVERFLOW__);
+
+                if (in.nlocals) {
+                    // mov rdi, rbx; mov ecx, nlocals; xor eax, eax; rep stosq
+                    bytes_({0x48, 0x89, 0xDF, 0xB9});
+                    int32_(in.nlocals);
+                    bytes_({0x31, 0xC0, 0xF3, 0x48, 0xAB});
+                }
+
+                // jmp target, the callee returns to the caller of this function
+                bytes_({0xE9});
+                rel32_(in.target);
+                break;
+
+            case RCMD_RET:
+                load_(XMM0, in.a);
+                store_(-in.nargs, XMM0);
+                bytes_({0xC3});
+                break;
+
+            case RCMD_LEAVE:
+                bytes_({0xC3});
+                break;
+
+            // the kernels of vector.h: pointers and n in rdi, rsi, rdx, rcx, the value in xmm0
+            case RCMD_VADD: case RCMD_VSUB: case RCMD_VMUL: case RCMD_VDIV: {
+                const VectorKernels& kernels = vector_kernels();
+                ram_pointer_(RDI, in.vector.dst);
+                ram_pointer_(RSI, in.vector.a);
+                ram_pointer_(RDX, in.vector.b);
+                count_(RCX, in.vector.n);
+                call_(reinterpret_cast<void*>(in.command == RCMD_VADD ? kernels.add :
+                                              in.command == RCMD_VSUB ? kernels.sub :
+                                              in.command == RCMD_VMUL ? kernels.mul : kernels.div));
+                break;
+            }
+
+            case RCMD_VFILL:
+                load_(XMM0, in.a);
+                ram_pointer_(RDI, in.vector.dst);
+                count_(RSI, in.vector.n);
+                call_(reinterpret_cast<void*>(vector_kernels().fill));
+                break;
+
+            case RCMD_VSCALE:
+                load_(XMM0, in.a);
+                ram_pointer_(RDI, in.vector.dst);
+                ram_pointer_(RSI, in.vector.a);
+                count_(RDX, in.vector.n);
+                call_(reinterpret_cast<void*>(vector_kernels().scale));
+                break;
+
+            case RCMD_VDOT:
+                ram_pointer_(RDI, in.vector.a);
+                ram_pointer_(RSI, in.vector.b);
+                count_(RDX, in.vector.n);
+                call_(reinterpret_cast<void*>(vector_kernels().dot));
+                store_(in.dst, XMM0);
+                break;
+
+            case RCMD_VSUM:
+                ram_pointer_(RDI, in.vector.a);
+                count_(RSI, in.vector.n);
+                call_(reinterpret_cast<void*>(vector_kernels().sum));
+                store_(in.dst, XMM0);
+                break;
+
+            case RCMD_DRAW:
+                // mov edi, width; mov esi, height; mov edx, ndata
+                bytes_({0xBF});
+                int32_(in.draw.width);
+                bytes_({0xBE});
+                int32_(in.draw.height);
+                bytes_({0xBA});
+                int32_(in.draw.ndata);
+                call_(reinterpret_cast<void*>(jit_draw));
+                break;
+        }
+    }
+};
+
+#endif
@@ -4,15 +4,7 @@
 #include <string.h>
 #include <map>
 #include "processor.h"
-
-
-template <typename T>
-static void* get_address(T new_value) {
-static T value;
-    
-    value = new_value;
-    return (void*)&value;
-}
+#include "bytecode.h"
 
 
 static inline void shift(char*& ch) {
@@ -35,36 +27,62 @@ static inline void make_fin(char* buf) {
 }
 
 
-static void parse_push_pop(size_t command, char* args_buf, FILE* out, size_t line) {
+// addressing mode of PUSH/POP by the look of its argument
+static unsigned char push_pop_mode(const char* args_buf) {
+    while (*args_buf == ' ')
+        ++args_buf;
+    return *args_buf == 'r' ? 1 : *args_buf == '[' ? 2 : 0;
+}
+
+
+// size in bytes of the instruction written on the line (comments already cut off), 0 if there is no instruction
+inline size_t line_size(char* st) {
+    char* ch = st;
+    while (*ch && *ch != ' ')
+        ++ch;
+
+    char saved = *ch;
+    *ch = 0;
+
+    size_t size = 0;
+    for (unsigned char i = 0; i < COMMANDS_NAMES.size(); ++i)
+        if (!strcmp(st, COMMANDS_NAMES[i])) {
+            size = instruction_size(i, i == CMD_PUSH || i == CMD_POP ? push_pop_mode(saved ? ch + 1 : ch) : 0);
+            break;
+        }
+
+    *ch = saved;
+    return size;
+}
+
+
+static void parse_push_pop(unsigned char command, char* args_buf, FILE* out, size_t line, size_t ram_size) {
     char* st = args_buf;
     shift(st);
 
     if (!*st) 
-        if (command == CMD_POP) {
-            fwrite(get_address<double>(0.0), sizeof(double), 1, out);
-            fwrite(get_address<double>(0.0), sizeof(double), 1, out);
-        }
+        if (command == CMD_POP)
+            emit_command(out, CMD_POP);
         else
             throw asm_exception(line, "PUSH: no arguments (need 1)");
     else if (*st == 'r') {
-        for (double k = 0; k < REGISTERS_NAMES.size(); ++k)
+        for (unsigned char k = 0; k < REGISTERS_NAMES.size(); ++k)
             if (!strcmp(st, REGISTERS_NAMES[k])) {
-                fwrite(get_address<double>(1.0), sizeof(double), 1, out);
-                fwrite(&k, sizeof(double), 1, out);
+                emit_command(out, command, 1, k);
                 break;
             }
             else if (k == REGISTERS_NAMES.size() - 1)
                 throw asm_exception(line, get_string("register \"%s\" not found", st));
     }
     else if (*st == '[') {
-        size_t index = 0;
+        unsigned char base = 0;
         ++st;
         shift(st);
         
         if (*st == 'r') {
             for (unsigned char k = 0; k < REGISTERS_NAMES.size(); ++k)
                 if (!strncmp(st, REGISTERS_NAMES[k], 3)) {
-                    index = k + 1;
+                    base = k + 1;
                     st += 3;
                     break;
                 }
@@ -74,9 +92,8 @@ static void parse_push_pop(size_t command, char* args_buf, FILE* out, size_t lin
             shift(st);
 
             if (*st == ']') {
-                double double_index = index;
-                fwrite(get_address<double>(2.0), sizeof(double), 1, out);
-                fwrite(&double_index, sizeof(double), 1, out);
+                emit_command(out, command, 2, base);
+                emit_int(out, 0);
                 return;
             }
             else if (*st != '+')
@@ -91,12 +108,11 @@ static void parse_push_pop(size_t command, char* args_buf, FILE* out, size_t lin
         shift(end);
         if (*end != ']')
             throw asm_exception(line, "wrong argument (access to RAM must be of form [rax+1])");
+        if (arg >= ram_size || arg > INT32_MAX)
+            throw asm_exception(line, get_string("RAM index is too big (RAM size = %zu)", ram_size));
 
-        index += arg * (__REGISTERS_NUMBER__ + 1);
-        
-        double double_index = index;
-        fwrite(get_address<double>(2.0), sizeof(double), 1, out);
-        fwrite(&double_index, sizeof(double), 1, out);
+        emit_command(out, command, 2, base);
+        emit_int(out, arg);
     }
     else if (command == CMD_PUSH) {
         char* end = nullptr;
@@ -105,15 +121,15 @@ static void parse_push_pop(size_t command, char* args_buf, FILE* out, size_t lin
         if (*end)
             throw asm_exception(line, "wrong argument (expected double)");
 
-        fwrite(get_address<double>(0.0), sizeof(double), 1, out);
-        fwrite(&arg, sizeof(double), 1, out);
+        emit_command(out, CMD_PUSH);
+        emit_double(out, arg);
     }
     else
         throw asm_exception(line, "POP: wrong argument format");
 }
 
 
-static void parse_jump(char* args_buf, FILE* out, size_t line, auto& labels) {
+static void parse_jump(unsigned char command, char* args_buf, FILE* out, size_t line, auto& labels) {
     char* st = args_buf;
     shift(st);
 
@@ -125,8 +141,8 @@ static void parse_jump(char* args_buf, FILE* out, size_t line, auto& labels) {
     if (!labels[st])
         throw asm_exception(line, get_string("label %s not found", st));
 
-    double tmp = labels[st] - 1 + strlen(SGN);
-    fwrite(&tmp, sizeof(double), 1, out);
+    emit_command(out, command);
+    emit_int(out, labels[st] - 1 + BYTECODE_HEADER_SIZE);
 }
 
 static std::string __name = "";
@@ -141,59 +157,61 @@ static void parse_fd(char* args_buf, FILE* out, auto& funcs) noexcept {
     *ch = 0;
     __name = st;
     
-    double tmp = funcs[st].endfunc - 1 + strlen(SGN);
-    fwrite(&tmp, sizeof(double), 1, out);
-    fwrite(&funcs[st].nargs, sizeof(double), 1, out);
-    fwrite(&funcs[st].nlocals, sizeof(double), 1, out);
+    emit_command(out, CMD_FD);
+    emit_int(out, funcs[st].endfunc - 1 + BYTECODE_HEADER_SIZE);
+    emit_int(out, funcs[st].nargs);
+    emit_int(out, funcs[st].nlocals);
 }
 
 
-static void parse_endfunc(FILE* out, auto& funcs) {
-    double tmp = funcs[__name].start - 1 + strlen(SGN);
-    fwrite(&tmp, sizeof(double), 1, out);
+static void parse_endfunc(unsigned char command, FILE* out, auto& funcs) {
+    emit_command(out, command);
+    emit_int(out, funcs[__name].start - 1 + BYTECODE_HEADER_SIZE);
 }
 
 
-static void parse_call(char* args_buf, FILE* out, size_t line, auto& funcs) {
+static void parse_call(unsigned char command, char* args_buf, FILE* out, size_t line, auto& funcs) {
     char* st = args_buf;
     shift(st);
 
     if (!funcs[st].start)
         throw asm_exception(line, get_string("function %s not found", st));
 
-    double tmp = funcs[st].start - 1 + strlen(SGN);
-    fwrite(&tmp, sizeof(double), 1, out);
+    emit_command(out, command);
+    emit_int(out, funcs[st].start - 1 + BYTECODE_HEADER_SIZE);
 }
 
 
-static void parse(unsigned char command, char* args_buf, FILE* out, size_t line, auto& labels, auto& funcs) {
+static void parse(unsigned char command, char* args_buf, FILE* out, size_t line, auto& labels, auto& funcs,
+                  size_t ram_size) {
     make_fin(args_buf);
 
     if (command == CMD_PUSH || command == CMD_POP)
-        parse_push_pop(command, args_buf, out, line);
+        parse_push_pop(command, args_buf, out, line, ram_size);
     else if (command == CMD_JMP || 
              command == CMD_JA || command == CMD_JB || command == CMD_JNE ||
              command == CMD_JAE || command == CMD_JBE || command == CMD_JE)
-        parse_jump(args_buf, out, line, labels);
+        parse_jump(command, args_buf, out, line, labels);
     else if (command == CMD_FD)
         parse_fd(args_buf, out, funcs);
-    else if (command == CMD_CALL)
-        parse_call(args_buf, out, line, funcs);
+    else if (command == CMD_CALL || command == CMD_TAILCALL)
+        parse_call(command, args_buf, out, line, funcs);
     else if (command == CMD_RET || command == CMD_LEAVE)
-        parse_endfunc(out, funcs);
+        parse_endfunc(command, out, funcs);
     else {
-        char* cur = args_buf;
+        emit_command(out, command);
 
+        char* cur = args_buf;
         for (size_t i = 0; i < ARGS_NUMBERS[command]; ++i) {
             shift(cur);
 
             char* end = nullptr;
-            double arg = strtod(cur, &end);
+            long arg = strtol(cur, &end, 10);
 
-            if (*end && *end != ' ')
-                throw asm_exception(line, "wrong arument (expected double)");
+            if (end == cur || (*end && *end != ' '))
+                throw asm_exception(line, "wrong arument (expected integer)");
             
-            fwrite(&arg, sizeof(double), 1, out);
+            emit_int(out, arg);
             cur = end;
         }
     }
@@ -2,20 +2,58 @@
 #include <stdlib.h>
 #include <string.h>
 #include <tuple>
-#include <math.h>
-#include "../stack/stack.h"
-#include "processor.h"
+#include <chrono>
+#include "interpreter.h"
 #include "reader.h"
-#include "verificator.h"
-#include "bmpwriter.h"
 
 
-std::array<double, __REGISTERS_NUMBER__> registers = {};
-std::array<double, RAM_SIZE> RAM = {};
+int main(int argc, char** argv) {
+    const char* input = nullptr;
+    size_t ninputs = 0;
+    bool stats = false;
+    ProcessorOptions options;
+    IOFormat io_format = IO_FIXED;
 
+    for (int i = 1; i < argc; ++i)
+        if (!strcmp(argv[i], "--stats"))
+            stats = true;
+        else if (!strcmp(argv[i], "--no-fuse"))
+            options.fuse = false;
+        else if (!strcmp(argv[i], "--registers"))
+            options.engine = ENGINE_REGISTERS;
+        else if (!strcmp(argv[i], "--jit"))
+            options.engine = ENGINE_JIT;
+        else if (!strcmp(argv[i], "--ram") && i + 1 < argc) {
+            char* end = nullptr;
+            options.ram_size = strtoull(argv[++i], &end, 10);
+            if (*end || !options.ram_size) {
+                fprintf(stderr, STYLE("1") "proc: " STYLE("31") "error: " STYLE("0") "--ram: expected a number of cells\n");
+                exit(1);
+            }
+        }
+        else if (!strcmp(argv[i], "--huge-pages"))
+            options.huge_pages = true;
+        else if (!strcmp(argv[i], "--profile"))
+            options.profile = true;
+        else if (!strcmp(argv[i], "--io") && i + 1 < argc) {
+            const char* format = argv[++i];
+            if (!strcmp(format, "fixed"))
+                io_format = IO_FIXED;
+            else if (!strcmp(format, "shortest"))
+                io_format = IO_SHORTEST;
+            else if (!strcmp(format, "binary"))
+                io_format = IO_BINARY;
+            else {
+                fprintf(stderr, STYLE("1") "proc: " STYLE("31") "error: " STYLE("0") "--io: expected fixed, shortest or binary\n");
+                exit(1);
+            }
+        }
+        else {
+            input = argv[i];
+            ++ninputs;
+        }
 
-int main(int argc, char** argv) {
-    if (argc != 2) {
+    if (ninputs != 1) {
         fprintf(stderr, STYLE("1") "proc: " STYLE("31") "error: " STYLE("0") "need 1 input file\n");
         exit(1);
     }
@@ -23,43 +61,68 @@ int main(int argc, char** argv) {
     const char* prog = nullptr;
     size_t size = 0;
 
-    std::tie(prog, size) = read_text(argv[1]);
+    std::tie(prog, size) = read_text(input);
 
+    Processor processor(options, ProcessorIO(io_format));
     try {
-        verify(prog, size);
+        processor.load(prog, size);
     } catch (verificator_exception& e) {
         fprintf(stderr, STYLE("1") "proc: " STYLE("31") "error:" STYLE("39") "\n"
                         "    byte %zu: " STYLE("0") "%s\n", 
                 e.byte, e.what());
         exit(1);
+    } catch (std::system_error& e) {
+        fprintf(stderr, STYLE("1") "proc: " STYLE("31") "error: " STYLE("0") "RAM: %s\n", e.what());
+        exit(1);
     }
+    delete[] prog;
 
-    int ip = strlen(SGN);
-    const char* fin = prog + size;
+    if (!processor.state().warning.empty())
+        fprintf(stderr, STYLE("1") "proc: " STYLE("35") "warning: " STYLE("0") "%s\n", processor.state().warning.c_str());
 
-    Stack<double> stack;
-    Stack<uintptr_t> call_stack;
-    Stack<size_t> locals_begin;
+    auto begin = std::chrono::steady_clock::now();
+    processor.run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
 
-    double args[__MAXIMAL_ARGS_NUMBER__];
-    bool end = false;
-    while (prog + ip != fin && !end) {
-        size_t command = *(unsigned char*)(prog + ip);
-        ++ip;
-        for (size_t i = 0; i < ARGS_NUMBERS[command]; ++i) {
-            args[i] = *(double*)(prog + ip);
-            ip += sizeof(double);
-        }
-        switch (command) {
+    const ProcessorState state = processor.state();
+    if (const Profiler* profiler = processor.profiler()) {
+        const std::string report = get_string("%s.profile", input);
+        const std::string collapsed = get_string("%s.folded", input);
 
-#define DEF_CMD(cmd, args_number, code) \
-            case CMD_##cmd: \
-                code; \
-                break;
-#include "commands.h"
-#undef DEF_CMD
+        const char* filename = report.c_str();
+        FILE* out = fopen(filename, "w");
+        if (!out)
+            PANIC();
+        profiler->write_report(out);
+        fclose(out);
 
-            default: __builtin_unreachable();
-        }
+        filename = collapsed.c_str();
+        out = fopen(filename, "w");
+        if (!out)
+            PANIC();
+        profiler->write_collapsed(out);
+        fclose(out);
+
+        fprintf(stderr, "proc: profile in %s, collapsed stacks in %s\n", report.c_str(), collapsed.c_str());
+    }
+
+    if (state.status == STATUS_FAILED) {
+        fprintf(stderr, STYLE("1") "proc: " STYLE("31") "error: " STYLE("0") "%s\n", state.error.c_str());
+        exit(1);
+    }
+
+    if (stats && state.engine == ENGINE_JIT)
+        fprintf(stderr, "proc: %.3lf s (jit)\n", elapsed.count());
+    else if (stats) {
+        std::string engine = state.engine == ENGINE_REGISTERS ? "register engine" :
+                             get_string("%d cached, %s stack", PROC_TOS_CACHE_SIZE, state.proven ? "unchecked" : "checked");
+        fprintf(stderr, "proc: %zu instructions in %.3lf s, %.2lf M instructions/s (%s dispatch, %s)\n",
+                state.executed, elapsed.count(), state.executed / elapsed.count() / 1e6,
+#ifdef PROC_THREADED_DISPATCH
+                "threaded",
+#else
+                "switch",
+#endif
+                engine.c_str());
     }
 }
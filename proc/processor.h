@@ -45,6 +45,36 @@ struct verificator_exception : public std::exception {
 };
 
 
+// the program is valid but can't be run by the register engine (translator.h)
+struct translator_exception : public std::exception {
+    std::string msg;
+    size_t instruction;
+
+
+    translator_exception(size_t instruction, std::string msg)
+        : msg(msg), instruction(instruction) {}
+
+    virtual const char* what() {
+        return msg.c_str();
+    }
+};
+
+
+// the program went wrong while running, only what the verifier cannot rule out
+struct runtime_exception : public std::exception {
+    std::string msg;
+    size_t instruction;
+
+
+    runtime_exception(size_t instruction, std::string msg)
+        : msg(msg), instruction(instruction) {}
+
+    virtual const char* what() {
+        return msg.c_str();
+    }
+};
+
+
 struct asm_exception : public std::exception {
     std::string msg;
     size_t line;
@@ -70,6 +100,20 @@ enum Command : unsigned char {
 };
 
 
+// superinstructions, they exist only in decoded programs
+enum FusedCommand : unsigned char {
+    __FIRST_FUSED__ = __COMMANDS_NUMBER__ - 1,
+
+#define DEF_CMD(cmd, args_number, code)
+#define DEF_FUSED(cmd, code) CMD_##cmd,
+#include "commands.h"
+#undef DEF_FUSED
+#undef DEF_CMD
+
+    __ALL_COMMANDS_NUMBER__
+};
+
+
 enum Register : unsigned char {
     rax,
     rbx,
@@ -116,4 +160,5 @@ constexpr size_t __MAXIMAL_ARGS_NUMBER__ = *std::max_element(ARGS_NUMBERS.begin(
 constexpr static auto COMMANDS_NAMES = get_commands_names_();
 constexpr static auto REGISTERS_NAMES = get_registers_names_();
 
+// cells of RAM unless the bytecode header or the processor asks for another size
 constexpr size_t RAM_SIZE = 1e6;
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <stdio.h>
+#include <stdint.h>
+#include "processor.h"
+#include "decoder.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#else
+    #include <chrono>
+#endif
+
+
+// Execution profile of the stack engine (Processor with ProcessorOptions::profile). The interpreter calls
+// step() before every instruction, the time since the previous step() goes to the previous instruction:
+// to its opcode, to the node of the call tree the program is in and, for a jump, whether it was taken is
+// seen from where it went. The call tree gives exclusive time per function, inclusive time (recursive
+// calls are not counted twice) and the collapsed stacks of flamegraph.pl. Functions are named by the
+// byte offset of their FD, the same number CALL has in the .dk file; the code outside functions is main.
+
+
+// cycles on x86, nanoseconds elsewhere
+static inline uint64_t profiler_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+class Profiler {
+public:
+    // program is not fused, offsets are from instruction_offsets()
+    Profiler(const std::vector<Instruction>& program, std::vector<size_t> offsets)
+        : program_(program), offsets_(std::move(offsets)), jumps_(program.size()) {
+        nodes_.push_back({-1, 0, 0, false, {}});
+    }
+
+    void step(size_t ip) {
+        const uint64_t now = profiler_clock();
+        if (previous_ != NONE)
+            account_(previous_, ip, now - last_);
+        previous_ = ip;
+        last_ = now;
+    }
+
+    // the last instruction is over, next is where the program goes on (when it does)
+    void pause(size_t next) {
+        if (previous_ != NONE)
+            account_(previous_, next, profiler_clock() - last_);
+        previous_ = NONE;
+    }
+
+    void write_report(FILE* out) const {
+        uint64_t total = 0;
+        for (const Opcode& opcode : opcodes_)
+            total += opcode.cycles;
+        total = std::max<uint64_t>(total, 1);
+
+        fprintf(out, "%-16s %14s %16s %10s %7s\n", "opcode", "count", TICKS, "per op", "%");
+        std::vector<int> order;
+        for (int command = 0; command < __ALL_COMMANDS_NUMBER__; ++command)
+            if (opcodes_[command].count)
+                order.push_back(command);
+        std::sort(order.begin(), order.end(), [this](int a, int b) { return opcodes_[a].cycles > opcodes_[b].cycles; });
+        for (int command : order)
+            fprintf(out, "%-16s %14llu %16llu %10.1lf %7.2lf\n", COMMANDS_NAMES[command],
+                    (unsigned long long)opcodes_[command].count, (unsigned long long)opcodes_[command].cycles,
+                    (double)opcodes_[command].cycles / opcodes_[command].count, 100.0 * opcodes_[command].cycles / total);
+
+        std::vector<Function> functions = functions_();
+        std::sort(functions.begin(), functions.end(), [](const Function& a, const Function& b) { return a.inclusive > b.inclusive; });
+        fprintf(out, "\n%-16s %14s %16s %16s %7s\n", "function", "calls", "inclusive", "exclusive", "%");
+        for (const Function& function : functions)
+            fprintf(out, "%-16s %14llu %16llu %16llu %7.2lf\n", function_name_(function.fd).c_str(),
+                    (unsigned long long)function.calls, (unsigned long long)function.inclusive,
+                    (unsigned long long)function.exclusive, 100.0 * function.exclusive / total);
+
+        order.clear();
+        for (size_t i = 0; i < program_.size(); ++i)
+            if (jumps_[i].taken || jumps_[i].not_taken)
+                order.push_back(i);
+        std::sort(order.begin(), order.end(), [this](int a, int b) {
+            return jumps_[a].taken + jumps_[a].not_taken > jumps_[b].taken + jumps_[b].not_taken;
+        });
+        fprintf(out, "\n%-16s %-8s %10s %14s %14s\n", "jump at", "command", "target", "taken", "not taken");
+        for (int i : order)
+            fprintf(out, "%-16zu %-8s %10zu %14llu %14llu\n", offsets_[i], COMMANDS_NAMES[program_[i].command],
+                    offset_of_(program_[i].target), (unsigned long long)jumps_[i].taken, (unsigned long long)jumps_[i].not_taken);
+    }
+
+    // one line per call stack: main;fd@40;fd@112 <exclusive time>
+    void write_collapsed(FILE* out) const {
+        std::vector<int> path;
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            if (!nodes_[i].self)
+                continue;
+
+            path.clear();
+            for (int node = i; node >= 0; node = node ? nodes_[node].parent : -1)
+                path.push_back(nodes_[node].fd);
+
+            for (size_t j = path.size(); j-- > 0; )
+                fprintf(out, "%s%s", function_name_(path[j]).c_str(), j ? ";" : "");
+            fprintf(out, " %llu\n", (unsigned long long)nodes_[i].self);
+        }
+    }
+
+private:
+    static constexpr size_t NONE = SIZE_MAX;
+#if defined(__x86_64__) || defined(__i386__)
+    static constexpr const char* TICKS = "cycles";
+#else
+    static constexpr const char* TICKS = "ns";
+#endif
+
+    struct Opcode {
+        uint64_t count;
+        uint64_t cycles;
+    };
+
+    struct Jump {
+        uint64_t taken;
+        uint64_t not_taken;
+    };
+
+    // the same function called along different paths gets different nodes
+    struct Node {
+        int fd;                             // FD of the function, -1 - main
+        int parent;
+        uint64_t self;
+        bool recursive;                     // the function is already on the path, its time is in an ancestor
+        std::vector<std::pair<int, int>> children;  // (fd, node)
+    };
+
+    struct Function {
+        int fd;
+        uint64_t calls;
+        uint64_t inclusive;
+        uint64_t exclusive;
+    };
+
+    const std::vector<Instruction>& program_;
+    std::vector<size_t> offsets_;
+
+    Opcode opcodes_[__ALL_COMMANDS_NUMBER__] = {};
+    std::vector<Jump> jumps_;
+    std::vector<Node> nodes_;
+    std::vector<uint64_t> calls_;           // per FD index
+    int node_ = 0;
+
+    size_t previous_ = NONE;
+    uint64_t last_ = 0;
+
+
+    void account_(size_t i, size_t next, uint64_t cycles) {
+        const Instruction& in = program_[i];
+        ++opcodes_[in.command].count;
+        opcodes_[in.command].cycles += cycles;
+        nodes_[node_].self += cycles;
+
+        if (is_jump(in.command))
+            ++(next == i + 1 ? jumps_[i].not_taken : jumps_[i].taken);
+        else if (in.command == CMD_CALL)
+            enter_(in.target - 1);
+        else if ((in.command == CMD_RET || in.command == CMD_LEAVE) && node_)
+            node_ = nodes_[node_].parent;
+        else if (in.command == CMD_TAILCALL) {
+            // the callee takes the place of the current function on the call stack
+            if (node_)
+                node_ = nodes_[node_].parent;
+            enter_(in.target - 1);
+        }
+    }
+
+    void enter_(int fd) {
+        if (calls_.size() <= (size_t)fd)
+            calls_.resize(fd + 1);
+        ++calls_[fd];
+
+        for (const std::pair<int, int>& child : nodes_[node_].children)
+            if (child.first == fd) {
+                node_ = child.second;
+                return;
+            }
+
+        bool recursive = false;
+        for (int node = node_; node && !recursive; node = nodes_[node].parent)
+            recursive = nodes_[node].fd == fd;
+
+        const int child = nodes_.size();
+        nodes_.push_back({fd, node_, 0, recursive, {}});
+        nodes_[node_].children.push_back({fd, child});
+        node_ = child;
+    }
+
+    std::vector<Function> functions_() const {
+        // children come after their parents
+        std::vector<uint64_t> inclusive(nodes_.size());
+        for (size_t i = nodes_.size(); i-- > 0; ) {
+            inclusive[i] += nodes_[i].self;
+            if (i)
+                inclusive[nodes_[i].parent] += inclusive[i];
+        }
+
+        std::vector<Function> functions;
+        std::vector<int> index(program_.size() + 1, -1);
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            const int fd = nodes_[i].fd;
+            int& at = index[fd + 1];
+            if (at < 0) {
+                at = functions.size();
+                functions.push_back({fd, fd >= 0 ? calls_[fd] : 1, 0, 0});
+            }
+
+            functions[at].exclusive += nodes_[i].self;
+            if (!nodes_[i].recursive)
+                functions[at].inclusive += inclusive[i];
+        }
+        return functions;
+    }
+
+    size_t offset_of_(int instruction) const {
+        return (size_t)instruction < offsets_.size() ? offsets_[instruction] :
+               offsets_.empty() ? BYTECODE_HEADER_SIZE : offsets_.back() + instruction_size(program_.back().command, program_.back().mode);
+    }
+
+    std::string function_name_(int fd) const {
+        return fd < 0 ? "main" : get_string("fd@%zu", offsets_[fd]);
+    }
+};
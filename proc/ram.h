@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <errno.h>
+#include <system_error>
+#include <sys/mman.h>
+
+
+// RAM of a Processor: a private anonymous mapping, so its size costs only address space and a page is
+// committed, already zeroed, when the program first touches it. Huge pages are a hint to the kernel
+// (transparent huge pages), the mapping works without them.
+class LazyRAM {
+public:
+    LazyRAM() = default;
+
+    ~LazyRAM() {
+        unmap_();
+    }
+
+    LazyRAM(const LazyRAM&) = delete;
+    LazyRAM& operator=(const LazyRAM&) = delete;
+
+    // size zeroed cells, whatever was mapped before is gone
+    void map(size_t size, bool huge_pages) {
+        unmap_();
+
+        void* where = mmap(nullptr, size * sizeof(double), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (where == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), "mmap");
+#ifdef MADV_HUGEPAGE
+        if (huge_pages)
+            madvise(where, size * sizeof(double), MADV_HUGEPAGE);
+#else
+        (void)huge_pages;
+#endif
+
+        data_ = (double*)where;
+        size_ = size;
+    }
+
+    double& operator[](size_t index) {
+        return data_[index];
+    }
+
+    double* data() {
+        return data_;
+    }
+
+    const double* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    double* data_ = nullptr;
+    size_t size_ = 0;
+
+    void unmap_() {
+        if (data_)
+            munmap(data_, size_ * sizeof(double));
+        data_ = nullptr;
+        size_ = 0;
+    }
+};
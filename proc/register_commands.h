@@ -0,0 +1,240 @@
+
+// handlers of the register engine (translator.h), operands are registers of the current frame:
+// negative - arguments, [0, nlocals) - locals, then the slots of the operand stack
+
+#define R(index) frame[index]
+#define RAM_ADDRESS(in) ((in).reg ? (size_t)registers[(in).reg - 1] + (in).shift : (in).shift)
+#define RAM_INDEX(in) ((in).bounded ? RAM_ADDRESS(in) : \
+    check_ram_index((in).reg ? registers[(in).reg - 1] : 0, (in).shift, RAM.size(), (in).origin))
+#define LEAVE_FRAME() { \
+    ip = calls.back().ip; \
+    fp = calls.back().fp; \
+    calls.pop_back(); \
+    frame = file.data() + fp; \
+}
+#define let double
+#define READ() io.read()
+#define WRITE(a) io.write(a)
+#define _EPS 1e-6
+#define ABS(a) ((a) >= 0 ? (a) : -(a))
+#define _EQUAL(a, b) (ABS((a) - (b)) <= _EPS)
+#define LESS(a, b) ((a) + _EPS < (b))
+#define GRT(a, b) ((b) + _EPS < (a))
+
+// a is the value that was on the top of the stack, b the one under it; K marks the constant operand:
+// _RR - both are registers, _RK - a is in.k, _KR - b is in.k
+#define DEF_BINARY(cmd, expr) \
+    DEF_ROP(cmd##_RR, { \
+        let a = R(in.a); \
+        let b = R(in.b); \
+        R(in.dst) = (expr); \
+    }) \
+    DEF_ROP(cmd##_RK, { \
+        let a = in.k; \
+        let b = R(in.b); \
+        R(in.dst) = (expr); \
+    }) \
+    DEF_ROP(cmd##_KR, { \
+        let a = R(in.a); \
+        let b = in.k; \
+        R(in.dst) = (expr); \
+    })
+
+#define DEF_BRANCH(cmd, condition) \
+    DEF_ROP(cmd##_RR, { \
+        let a = R(in.a); \
+        let b = R(in.b); \
+        if (condition) ip = in.target; \
+    }) \
+    DEF_ROP(cmd##_RK, { \
+        let a = in.k; \
+        let b = R(in.b); \
+        if (condition) ip = in.target; \
+    }) \
+    DEF_ROP(cmd##_KR, { \
+        let a = R(in.a); \
+        let b = in.k; \
+        if (condition) ip = in.target; \
+    })
+
+#define DEF_UNARY(cmd, expr) \
+    DEF_ROP(cmd, { \
+        let a = R(in.a); \
+        R(in.dst) = (expr); \
+    })
+
+
+DEF_ROP(HALT, {
+    HALT();
+})
+
+DEF_ROP(MOV, {
+    R(in.dst) = R(in.a);
+})
+
+DEF_ROP(LOADK, {
+    R(in.dst) = in.k;
+})
+
+DEF_ROP(GETR, {
+    R(in.dst) = registers[in.reg];
+})
+
+DEF_ROP(SETR, {
+    registers[in.reg] = R(in.a);
+})
+
+DEF_ROP(GETM, {
+    R(in.dst) = RAM[RAM_INDEX(in)];
+})
+
+DEF_ROP(SETM, {
+    RAM[RAM_INDEX(in)] = R(in.a);
+})
+
+DEF_BINARY(ADD, a + b)
+DEF_BINARY(SUB, b - a)
+DEF_BINARY(MUL, a * b)
+DEF_BINARY(DIV, b / a)
+DEF_BINARY(MOD, fmod(b, a))
+DEF_BINARY(POW, pow(b, a))
+DEF_BINARY(EQ, (double)_EQUAL(a, b))
+DEF_BINARY(NE, (double)!_EQUAL(a, b))
+DEF_BINARY(LT, (double)LESS(b, a))
+DEF_BINARY(LE, (double)!GRT(b, a))
+DEF_BINARY(GT, (double)GRT(b, a))
+DEF_BINARY(GE, (double)!LESS(b, a))
+
+DEF_UNARY(ABS, ABS(a))
+DEF_UNARY(INC, a + 1)
+DEF_UNARY(DEC, a - 1)
+DEF_UNARY(SQRT, sqrt(a))
+DEF_UNARY(SQR, a * a)
+DEF_UNARY(SIN, sin(a))
+DEF_UNARY(COS, cos(a))
+DEF_UNARY(TG, tan(a))
+DEF_UNARY(ARCSIN, asin(a))
+DEF_UNARY(ARCCOS, acos(a))
+DEF_UNARY(ARCTG, atan(a))
+DEF_UNARY(SH, sinh(a))
+DEF_UNARY(CH, cosh(a))
+DEF_UNARY(TH, tanh(a))
+DEF_UNARY(ARCSH, asinh(a))
+DEF_UNARY(ARCCH, acosh(a))
+DEF_UNARY(ARCTH, atanh(a))
+DEF_UNARY(LOG, log(a))
+DEF_UNARY(EXP, exp(a))
+
+DEF_ROP(IN, {
+    R(in.dst) = READ();
+})
+
+DEF_ROP(OUT, {
+    WRITE(R(in.a));
+})
+
+DEF_ROP(JMP, {
+    ip = in.target;
+})
+
+DEF_BRANCH(JA, GRT(b, a))
+DEF_BRANCH(JAE, !LESS(b, a))
+DEF_BRANCH(JB, LESS(b, a))
+DEF_BRANCH(JBE, !GRT(b, a))
+DEF_BRANCH(JE, _EQUAL(b, a))
+DEF_BRANCH(JNE, !_EQUAL(b, a))
+
+// the callee frame starts in.shift registers above the current one, its arguments are right below it
+DEF_ROP(CALL, {
+    calls.push_back({ip, fp});
+    fp += in.shift;
+    if (fp + in.size > file.size())
+        file.resize(2 * (fp + in.size));
+    frame = file.data() + fp;
+
+    for (int i = 0; i < in.nlocals; ++i)
+        R(i) = 0;
+
+    ip = in.target;
+})
+
+// the arguments (in.nargs registers from in.a) move to in.dst, where the arguments of the current function
+// are, and the callee frame takes the place of the current one: it returns to the caller of this function
+DEF_ROP(TAILCALL, {
+    for (int i = 0; i < in.nargs; ++i)
+        R(in.dst + i) = R(in.a + i);
+
+    fp += in.shift;
+    if (fp + in.size > file.size())
+        file.resize(2 * (fp + in.size));
+    frame = file.data() + fp;
+
+    for (int i = 0; i < in.nlocals; ++i)
+        R(i) = 0;
+
+    ip = in.target;
+})
+
+// the result takes the place of the arguments in the frame of the caller
+DEF_ROP(RET, {
+    R(-in.nargs) = R(in.a);
+    LEAVE_FRAME();
+})
+
+DEF_ROP(LEAVE, {
+    LEAVE_FRAME();
+})
+
+DEF_ROP(DRAW, {
+    io.draw(in.draw.width, in.draw.height, RAM.data(), RAM.data() + in.draw.ndata);
+})
+
+// vector commands over RAM: n cells from dst, a and b (vector.h), R(in.a) - the value of VFILL, VSCALE
+DEF_ROP(VADD, {
+    vector_add(&RAM[in.vector.dst], &RAM[in.vector.a], &RAM[in.vector.b], in.vector.n);
+})
+
+DEF_ROP(VSUB, {
+    vector_sub(&RAM[in.vector.dst], &RAM[in.vector.a], &RAM[in.vector.b], in.vector.n);
+})
+
+DEF_ROP(VMUL, {
+    vector_mul(&RAM[in.vector.dst], &RAM[in.vector.a], &RAM[in.vector.b], in.vector.n);
+})
+
+DEF_ROP(VDIV, {
+    vector_div(&RAM[in.vector.dst], &RAM[in.vector.a], &RAM[in.vector.b], in.vector.n);
+})
+
+DEF_ROP(VFILL, {
+    vector_fill(&RAM[in.vector.dst], R(in.a), in.vector.n);
+})
+
+DEF_ROP(VSCALE, {
+    vector_scale(&RAM[in.vector.dst], &RAM[in.vector.a], R(in.a), in.vector.n);
+})
+
+DEF_ROP(VDOT, {
+    R(in.dst) = vector_dot(&RAM[in.vector.a], &RAM[in.vector.b], in.vector.n);
+})
+
+DEF_ROP(VSUM, {
+    R(in.dst) = vector_sum(&RAM[in.vector.a], in.vector.n);
+})
+
+
+#undef DEF_BINARY
+#undef DEF_BRANCH
+#undef DEF_UNARY
+#undef R
+#undef RAM_ADDRESS
+#undef RAM_INDEX
+#undef LEAVE_FRAME
+#undef READ
+#undef WRITE
+#undef let
+#undef _EPS
+#undef ABS
+#undef LESS
+#undef _EQUAL
+#undef GRT
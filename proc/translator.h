@@ -0,0 +1,497 @@
+#pragma once
+
+#include <vector>
+#include "processor.h"
+#include "decoder.h"
+#include "verificator.h"
+
+
+// Translation of decoded stack programs into three-address code over a file of virtual registers.
+// A function frame is laid out exactly like its part of the operand stack (arguments right below the
+// frame, then locals, then one register per stack slot), so every stack slot gets a fixed register once
+// the depth of the stack before each instruction is known. GET_LOCAL and PUSH of a constant produce no
+// code at all: the translator remembers where a value is and lets the instruction that consumes it read
+// the local or take the constant directly. Values are moved into their slots only at block boundaries,
+// before calls, and when the local they refer to is about to change.
+
+
+enum RegisterCommand : unsigned char {
+
+#define DEF_ROP(cmd, code) RCMD_##cmd,
+#include "register_commands.h"
+#undef DEF_ROP
+
+    __REGISTER_COMMANDS_NUMBER__
+};
+
+
+struct RegisterInstruction {
+    unsigned char command;
+    unsigned char reg;       // GETR, SETR: register; GETM, SETM: base register + 1 (0 - no base)
+    bool bounded;            // GETM, SETM: the verifier proved the address is inside RAM
+    int origin;              // GETM, SETM: the instruction of the stack program, for errors
+    int dst;                 // frame registers; TAILCALL: where the arguments go
+    int a, b;                // a - what was the top of the stack, b - the value under it
+    union {
+        struct {
+            int target;      // jumps, CALL, TAILCALL: instruction index
+            int shift;       // GETM, SETM: RAM offset; CALL, TAILCALL: start of the callee frame
+            int nargs;       // RET: arguments of the function; TAILCALL: of the callee
+            int nlocals;     // CALL, TAILCALL: locals of the callee
+        };
+        DrawOperands draw;
+        VectorRanges vector;
+    };
+    int size;                // CALL, TAILCALL: registers the callee frame needs
+    double k;                // constant operand
+};
+
+
+struct RegisterProgram {
+    std::vector<RegisterInstruction> code;
+    size_t size;             // registers the outermost frame needs
+};
+
+
+class RegisterTranslator {
+public:
+    RegisterTranslator(const std::vector<Instruction>& program, const StackAnalysis& analysis)
+        : program_(program), n_(program.size()), analysis_(analysis),
+          depth_(analysis.depth), function_of_(analysis.function),
+          frame_size_(analysis.frame_size), returns_(analysis.returns) {}
+
+    RegisterProgram translate() {
+        // stack slots become registers only when their depth is known
+        if (!analysis_.proven)
+            throw translator_exception(analysis_.instruction, analysis_.reason);
+        find_leaders_();
+
+        index_.assign(n_ + 1, 0);
+        bool live = false;
+
+        for (size_t i = 0; i < n_; ++i) {
+            if (leader_[i]) {
+                if (live)
+                    flush_();
+                result_ = false;
+            }
+            index_[i] = code_.size();
+
+            if (depth_[i] == __UNREACHED__) {
+                live = false;
+                continue;
+            }
+
+            if (leader_[i] || !live) {
+                function_ = function_of_[i];
+                values_.assign(depth_[i], StackValue{});
+            }
+            live = translate_(i);
+        }
+
+        index_[n_] = code_.size();
+        emit_(RCMD_HALT);
+
+        for (auto& in : code_)
+            if (in.command == RCMD_JMP || in.command == RCMD_CALL || in.command == RCMD_TAILCALL ||
+                is_branch_(in.command))
+                in.target = index_[in.target];
+
+        return {code_, (size_t)frame_size_[n_]};
+    }
+
+private:
+    static constexpr int __UNREACHED__ = StackAnalysis::__UNREACHED__;
+
+    // where a value of the operand stack is while its instruction is translated
+    struct StackValue {
+        enum : unsigned char { SLOT, REGISTER, CONSTANT } kind = SLOT;
+        int reg = 0;         // REGISTER: frame register (local or argument)
+        double k = 0;        // CONSTANT
+    };
+
+    const std::vector<Instruction>& program_;
+    const size_t n_;
+
+    // see StackAnalysis, a stack slot of the frame is a register here
+    const StackAnalysis& analysis_;
+    const std::vector<int>& depth_;
+    const std::vector<int>& function_of_;
+    const std::vector<int>& frame_size_;
+    const std::vector<int>& returns_;
+
+    std::vector<bool> leader_;
+
+    std::vector<RegisterInstruction> code_;
+    std::vector<size_t> index_;
+
+    int function_ = -1;
+    std::vector<StackValue> values_;
+    bool result_ = false;     // the last instruction emitted wrote the top slot and nothing read it yet
+
+
+    static bool is_branch_(unsigned char command) {
+        switch (command) {
+            case RCMD_JA_RR: case RCMD_JA_RK: case RCMD_JA_KR:
+            case RCMD_JAE_RR: case RCMD_JAE_RK: case RCMD_JAE_KR:
+            case RCMD_JB_RR: case RCMD_JB_RK: case RCMD_JB_KR:
+            case RCMD_JBE_RR: case RCMD_JBE_RK: case RCMD_JBE_KR:
+            case RCMD_JE_RR: case RCMD_JE_RK: case RCMD_JE_KR:
+            case RCMD_JNE_RR: case RCMD_JNE_RK: case RCMD_JNE_KR:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // _RR variant of the register command for binary operations and conditional jumps, 0 for the rest
+    static unsigned char binary_(unsigned char command) {
+        switch (command) {
+            case CMD_ADD: return RCMD_ADD_RR;
+            case CMD_SUB: return RCMD_SUB_RR;
+            case CMD_MUL: return RCMD_MUL_RR;
+            case CMD_DIV: return RCMD_DIV_RR;
+            case CMD_MOD: return RCMD_MOD_RR;
+            case CMD_POW: return RCMD_POW_RR;
+            case CMD_EQ: return RCMD_EQ_RR;
+            case CMD_NE: return RCMD_NE_RR;
+            case CMD_LT: return RCMD_LT_RR;
+            case CMD_LE: return RCMD_LE_RR;
+            case CMD_GT: return RCMD_GT_RR;
+            case CMD_GE: return RCMD_GE_RR;
+            case CMD_JA: return RCMD_JA_RR;
+            case CMD_JAE: return RCMD_JAE_RR;
+            case CMD_JB: return RCMD_JB_RR;
+            case CMD_JBE: return RCMD_JBE_RR;
+            case CMD_JE: return RCMD_JE_RR;
+            case CMD_JNE: return RCMD_JNE_RR;
+            default: return 0;
+        }
+    }
+
+    static unsigned char unary_(unsigned char command) {
+        switch (command) {
+            case CMD_ABS: return RCMD_ABS;
+            case CMD_INC: return RCMD_INC;
+            case CMD_DEC: return RCMD_DEC;
+            case CMD_SQRT: return RCMD_SQRT;
+            case CMD_SQR: return RCMD_SQR;
+            case CMD_SIN: return RCMD_SIN;
+            case CMD_COS: return RCMD_COS;
+            case CMD_TG: return RCMD_TG;
+            case CMD_ARCSIN: return RCMD_ARCSIN;
+            case CMD_ARCCOS: return RCMD_ARCCOS;
+            case CMD_ARCTG: return RCMD_ARCTG;
+            case CMD_SH: return RCMD_SH;
+            case CMD_CH: return RCMD_CH;
+            case CMD_TH: return RCMD_TH;
+            case CMD_ARCSH: return RCMD_ARCSH;
+            case CMD_ARCCH: return RCMD_ARCCH;
+            case CMD_ARCTH: return RCMD_ARCTH;
+            case CMD_LOG: return RCMD_LOG;
+            case CMD_EXP: return RCMD_EXP;
+            default: return 0;
+        }
+    }
+
+    static unsigned char vector_(unsigned char command) {
+        switch (command) {
+            case CMD_VADD: return RCMD_VADD;
+            case CMD_VSUB: return RCMD_VSUB;
+            case CMD_VMUL: return RCMD_VMUL;
+            case CMD_VDIV: return RCMD_VDIV;
+            case CMD_VFILL: return RCMD_VFILL;
+            case CMD_VSCALE: return RCMD_VSCALE;
+            case CMD_VDOT: return RCMD_VDOT;
+            case CMD_VSUM: return RCMD_VSUM;
+            default: return 0;
+        }
+    }
+
+    int nlocals_(int function) const {
+        return function < 0 ? 0 : program_[function].nlocals;
+    }
+
+    // control may come to a leader from somewhere else than the previous instruction
+    void find_leaders_() {
+        leader_.assign(n_ + 1, false);
+        leader_[0] = true;
+        for (size_t i = 0; i < n_; ++i) {
+            const Instruction& in = program_[i];
+            if (is_jump(in.command) || in.command == CMD_FD || in.command == CMD_CALL || in.command == CMD_TAILCALL)
+                leader_[in.target] = true;
+            if (in.command == CMD_CALL)
+                leader_[i + 1] = true;
+        }
+    }
+
+    int slot_(size_t depth) const {
+        return nlocals_(function_) + depth;
+    }
+
+    int reg_(size_t depth) const {
+        return values_[depth].kind == StackValue::REGISTER ? values_[depth].reg : slot_(depth);
+    }
+
+    RegisterInstruction& emit_(unsigned char command) {
+        RegisterInstruction in = {};
+        in.command = command;
+        code_.push_back(in);
+        result_ = false;
+        return code_.back();
+    }
+
+    // for instructions that write the top slot
+    RegisterInstruction& emit_result_(unsigned char command) {
+        RegisterInstruction& in = emit_(command);
+        in.dst = slot_(values_.size() - 1);
+        result_ = true;
+        return in;
+    }
+
+    void materialize_(size_t depth) {
+        StackValue& value = values_[depth];
+        if (value.kind == StackValue::REGISTER)
+            emit_(RCMD_MOV).a = value.reg;
+        else if (value.kind == StackValue::CONSTANT)
+            emit_(RCMD_LOADK).k = value.k;
+        else
+            return;
+
+        code_.back().dst = slot_(depth);
+        value = StackValue{};
+    }
+
+    void flush_() {
+        for (size_t depth = 0; depth < values_.size(); ++depth)
+            materialize_(depth);
+    }
+
+    // the values read from reg have to be saved before it is written
+    void protect_(int reg, size_t depth) {
+        for (size_t i = 0; i < depth; ++i)
+            if (values_[i].kind == StackValue::REGISTER && values_[i].reg == reg)
+                materialize_(i);
+    }
+
+    // register holding the top of the stack, which is popped
+    int operand_() {
+        materialize_if_constant_(values_.size() - 1);
+        const int reg = reg_(values_.size() - 1);
+        values_.pop_back();
+        return reg;
+    }
+
+    void materialize_if_constant_(size_t depth) {
+        if (values_[depth].kind == StackValue::CONSTANT)
+            materialize_(depth);
+    }
+
+    void push_(StackValue value) {
+        values_.push_back(value);
+    }
+
+    // a - the top, b - the value under it; both are popped
+    void binary_operands_(RegisterInstruction& in) {
+        const size_t a = values_.size() - 1, b = values_.size() - 2;
+        if (values_[a].kind == StackValue::CONSTANT) {
+            in.command += 1;
+            in.k = values_[a].k;
+        } else if (values_[b].kind == StackValue::CONSTANT) {
+            in.command += 2;
+            in.k = values_[b].k;
+        }
+
+        in.a = reg_(a);
+        in.b = reg_(b);
+        values_.resize(b);
+    }
+
+    void set_local_(int reg) {
+        const size_t top = values_.size() - 1;
+        protect_(reg, top);
+
+        StackValue value = values_[top];
+        if (value.kind == StackValue::SLOT && result_ && code_.back().dst == slot_(top))
+            code_.back().dst = reg;
+        else if (value.kind == StackValue::CONSTANT)
+            emit_(RCMD_LOADK).k = value.k;
+        else if (reg_(top) != reg)
+            emit_(RCMD_MOV).a = reg_(top);
+        else {
+            values_.pop_back();
+            return;
+        }
+
+        code_.back().dst = reg;
+        values_.pop_back();
+        result_ = false;
+    }
+
+    // returns false if control never goes to the next instruction from here
+    bool translate_(size_t i) {
+        const Instruction& in = program_[i];
+
+        if (unsigned char command = binary_(in.command)) {
+            // a register is needed for at least one of the operands
+            if (values_[values_.size() - 1].kind == StackValue::CONSTANT)
+                materialize_if_constant_(values_.size() - 2);
+
+            if (is_jump(in.command)) {
+                for (size_t depth = 0; depth + 2 < values_.size(); ++depth)
+                    materialize_(depth);
+                RegisterInstruction& branch = emit_(command);
+                branch.target = in.target;
+                binary_operands_(branch);
+                return true;
+            }
+
+            RegisterInstruction operation = {};
+            operation.command = command;
+            binary_operands_(operation);
+            push_({});
+
+            RegisterInstruction& result = emit_result_(operation.command);
+            result.a = operation.a;
+            result.b = operation.b;
+            result.k = operation.k;
+            return true;
+        }
+
+        if (unsigned char command = unary_(in.command)) {
+            const int a = operand_();
+            push_({});
+            emit_result_(command).a = a;
+            return true;
+        }
+
+        if (unsigned char command = vector_(in.command)) {
+            // VFILL and VSCALE take a value from the stack, VDOT and VSUM leave one
+            const int a = in.command == CMD_VFILL || in.command == CMD_VSCALE ? operand_() : 0;
+            if (in.command == CMD_VDOT || in.command == CMD_VSUM)
+                push_({});
+
+            RegisterInstruction& vector = in.command == CMD_VDOT || in.command == CMD_VSUM ? emit_result_(command)
+                                                                                          : emit_(command);
+            vector.a = a;
+            vector.vector = in.vector;
+            return true;
+        }
+
+        switch (in.command) {
+            case CMD_PUSH:
+                if (in.mode == 0) {
+                    StackValue value;
+                    value.kind = StackValue::CONSTANT;
+                    value.k = in.value;
+                    push_(value);
+                } else {
+                    push_({});
+                    RegisterInstruction& load = emit_result_(in.mode == 1 ? RCMD_GETR : RCMD_GETM);
+                    load.reg = in.reg;
+                    load.shift = in.shift;
+                    load.bounded = in.bounded;
+                    load.origin = i;
+                }
+                return true;
+
+            case CMD_POP:
+                if (in.mode == 0)
+                    values_.pop_back();
+                else {
+                    const int a = operand_();
+                    RegisterInstruction& store = emit_(in.mode == 1 ? RCMD_SETR : RCMD_SETM);
+                    store.a = a;
+                    store.reg = in.reg;
+                    store.shift = in.shift;
+                    store.bounded = in.bounded;
+                    store.origin = i;
+                }
+                return true;
+
+            case CMD_GET_LOCAL:
+            case CMD_GET_ARG: {
+                StackValue value;
+                value.kind = StackValue::REGISTER;
+                value.reg = in.command == CMD_GET_LOCAL ? in.target : -1 - in.target;
+                push_(value);
+                return true;
+            }
+
+            case CMD_SET_LOCAL:
+                set_local_(in.target);
+                return true;
+
+            case CMD_IN:
+                push_({});
+                emit_result_(RCMD_IN);
+                return true;
+
+            case CMD_OUT: {
+                const int a = operand_();
+                emit_(RCMD_OUT).a = a;
+                return true;
+            }
+
+            case CMD_JMP:
+            case CMD_FD:
+                flush_();
+                emit_(RCMD_JMP).target = in.target;
+                return false;
+
+            case CMD_CALL: {
+                flush_();
+                const int fd = in.target - 1;
+
+                RegisterInstruction& call = emit_(RCMD_CALL);
+                call.target = in.target;
+                call.shift = slot_(values_.size());
+                call.nlocals = in.nlocals;
+                call.size = frame_size_[fd];
+
+                values_.resize(values_.size() - in.nargs);
+                if (returns_[fd] == 1)
+                    push_({});
+                return true;
+            }
+
+            case CMD_TAILCALL: {
+                flush_();
+                RegisterInstruction& call = emit_(RCMD_TAILCALL);
+                call.target = in.target;
+                call.dst = -in.shift;
+                call.a = slot_(values_.size() - in.nargs);
+                call.nargs = in.nargs;
+                call.shift = in.nargs - in.shift;
+                call.nlocals = in.nlocals;
+                call.size = frame_size_[in.target - 1];
+                return false;
+            }
+
+            case CMD_RET: {
+                const int a = operand_();
+                RegisterInstruction& ret = emit_(RCMD_RET);
+                ret.a = a;
+                ret.nargs = in.nargs;
+                return false;
+            }
+
+            case CMD_LEAVE:
+                emit_(RCMD_LEAVE);
+                return false;
+
+            case CMD_END:
+                emit_(RCMD_HALT);
+                return false;
+
+            case CMD_DRAW: {
+                RegisterInstruction& draw = emit_(RCMD_DRAW);
+                draw.draw = in.draw;
+                return true;
+            }
+
+            default:
+                return true;
+        }
+    }
+};
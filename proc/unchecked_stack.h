@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+
+
+// The part of the interface of ../stack/stack.h proc uses, without canaries, checksums and the check for
+// popping an empty stack. Only for programs StackVerifier proved, they never pop more than they pushed.
+template <typename T>
+class UncheckedStack {
+public:
+    void push(const T& item) {
+        if (size_ == items_.size())
+            items_.resize(std::max<size_t>(2 * size_, INITIAL_CAPACITY));
+        items_[size_++] = item;
+    }
+
+    T pop() {
+        return items_[--size_];
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return !size_;
+    }
+
+    T& operator[](size_t index) {
+        return items_[index];
+    }
+
+    T& top() {
+        return items_[size_ - 1];
+    }
+
+    // n default values (zeros) in one step
+    void grow(size_t n) {
+        if (items_.size() - size_ < n)
+            items_.resize(std::max(2 * items_.size(), size_ + n));
+        std::fill_n(items_.begin() + size_, n, T());
+        size_ += n;
+    }
+
+    void drop(size_t n) {
+        size_ -= n;
+    }
+
+private:
+    static constexpr size_t INITIAL_CAPACITY = 128;
+
+    // items_[size_..] are free, the vector only grows
+    std::vector<T> items_;
+    size_t size_ = 0;
+};
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <stddef.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(PROC_NO_SIMD)
+    #define PROC_AVX2
+    #include <immintrin.h>
+#endif
+
+
+// Kernels of the vector commands (VADD ... VSUM in commands.h) over ranges of RAM. The AVX2 kernels are
+// taken when the CPU has AVX2, the scalar ones otherwise (or always with PROC_NO_SIMD). The verifier has
+// already checked the ranges, dst is either a source itself or does not overlap it.
+//
+// VDOT and VSUM add element i to lane i % VECTOR_LANES and then the lanes pairwise in a fixed order,
+// both kernels and the copy dk2c writes into its output do exactly that, so the sum does not depend on
+// which of them runs (as long as the compiler does not contract a * b + c into an FMA).
+
+
+constexpr size_t VECTOR_LANES = 16;
+
+// (0 + 4 + 8 + 12) + (1 + 5 + 9 + 13) + ... in the order four AVX2 accumulators are added in
+static double vector_lanes_sum(const double* lane) {
+    double quarter[4];
+    for (int j = 0; j < 4; ++j)
+        quarter[j] = (lane[j] + lane[4 + j]) + (lane[8 + j] + lane[12 + j]);
+    return (quarter[0] + quarter[1]) + (quarter[2] + quarter[3]);
+}
+
+
+#define DEF_VECTOR_BINARY(name, op) \
+    static void vector_##name##_scalar(double* dst, const double* a, const double* b, size_t n) { \
+        for (size_t i = 0; i < n; ++i) \
+            dst[i] = a[i] op b[i]; \
+    }
+
+DEF_VECTOR_BINARY(add, +)
+DEF_VECTOR_BINARY(sub, -)
+DEF_VECTOR_BINARY(mul, *)
+DEF_VECTOR_BINARY(div, /)
+
+#undef DEF_VECTOR_BINARY
+
+static void vector_fill_scalar(double* dst, double k, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = k;
+}
+
+static void vector_scale_scalar(double* dst, const double* a, double k, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = a[i] * k;
+}
+
+static double vector_dot_scalar(const double* a, const double* b, size_t n) {
+    double lane[VECTOR_LANES] = {};
+    for (size_t i = 0; i < n; ++i)
+        lane[i % VECTOR_LANES] += a[i] * b[i];
+    return vector_lanes_sum(lane);
+}
+
+static double vector_sum_scalar(const double* a, size_t n) {
+    double lane[VECTOR_LANES] = {};
+    for (size_t i = 0; i < n; ++i)
+        lane[i % VECTOR_LANES] += a[i];
+    return vector_lanes_sum(lane);
+}
+
+
+#ifdef PROC_AVX2
+
+#define DEF_VECTOR_BINARY(name, op, avx2) \
+    __attribute__((target("avx2"))) \
+    static void vector_##name##_avx2(double* dst, const double* a, const double* b, size_t n) { \
+        size_t i = 0; \
+        for (; i + 4 <= n; i += 4) \
+            _mm256_storeu_pd(dst + i, avx2(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))); \
+        for (; i < n; ++i) \
+            dst[i] = a[i] op b[i]; \
+    }
+
+DEF_VECTOR_BINARY(add, +, _mm256_add_pd)
+DEF_VECTOR_BINARY(sub, -, _mm256_sub_pd)
+DEF_VECTOR_BINARY(mul, *, _mm256_mul_pd)
+DEF_VECTOR_BINARY(div, /, _mm256_div_pd)
+
+#undef DEF_VECTOR_BINARY
+
+__attribute__((target("avx2")))
+static void vector_fill_avx2(double* dst, double k, size_t n) {
+    const __m256d value = _mm256_set1_pd(k);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(dst + i, value);
+    for (; i < n; ++i)
+        dst[i] = k;
+}
+
+__attribute__((target("avx2")))
+static void vector_scale_avx2(double* dst, const double* a, double k, size_t n) {
+    const __m256d factor = _mm256_set1_pd(k);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), factor));
+    for (; i < n; ++i)
+        dst[i] = a[i] * k;
+}
+
+// four accumulators of four lanes each are the VECTOR_LANES lanes, the tail goes on like the scalar kernel
+__attribute__((target("avx2")))
+static double vector_dot_avx2(const double* a, const double* b, size_t n) {
+    __m256d sum[4] = {_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()};
+    size_t i = 0;
+    for (; i + VECTOR_LANES <= n; i += VECTOR_LANES)
+        for (int j = 0; j < 4; ++j)
+            sum[j] = _mm256_add_pd(sum[j], _mm256_mul_pd(_mm256_loadu_pd(a + i + 4 * j), _mm256_loadu_pd(b + i + 4 * j)));
+
+    double lane[VECTOR_LANES];
+    for (int j = 0; j < 4; ++j)
+        _mm256_storeu_pd(lane + 4 * j, sum[j]);
+    for (; i < n; ++i)
+        lane[i % VECTOR_LANES] += a[i] * b[i];
+    return vector_lanes_sum(lane);
+}
+
+__attribute__((target("avx2")))
+static double vector_sum_avx2(const double* a, size_t n) {
+    __m256d sum[4] = {_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()};
+    size_t i = 0;
+    for (; i + VECTOR_LANES <= n; i += VECTOR_LANES)
+        for (int j = 0; j < 4; ++j)
+            sum[j] = _mm256_add_pd(sum[j], _mm256_loadu_pd(a + i + 4 * j));
+
+    double lane[VECTOR_LANES];
+    for (int j = 0; j < 4; ++j)
+        _mm256_storeu_pd(lane + 4 * j, sum[j]);
+    for (; i < n; ++i)
+        lane[i % VECTOR_LANES] += a[i];
+    return vector_lanes_sum(lane);
+}
+
+#endif
+
+
+struct VectorKernels {
+    void (*add)(double* dst, const double* a, const double* b, size_t n);
+    void (*sub)(double* dst, const double* a, const double* b, size_t n);
+    void (*mul)(double* dst, const double* a, const double* b, size_t n);
+    void (*div)(double* dst, const double* a, const double* b, size_t n);
+    void (*fill)(double* dst, double k, size_t n);
+    void (*scale)(double* dst, const double* a, double k, size_t n);
+    double (*dot)(const double* a, const double* b, size_t n);
+    double (*sum)(const double* a, size_t n);
+};
+
+static const VectorKernels& vector_kernels() {
+    static const VectorKernels scalar = {
+        vector_add_scalar, vector_sub_scalar, vector_mul_scalar, vector_div_scalar,
+        vector_fill_scalar, vector_scale_scalar, vector_dot_scalar, vector_sum_scalar
+    };
+#ifdef PROC_AVX2
+    static const VectorKernels avx2 = {
+        vector_add_avx2, vector_sub_avx2, vector_mul_avx2, vector_div_avx2,
+        vector_fill_avx2, vector_scale_avx2, vector_dot_avx2, vector_sum_avx2
+    };
+    static const bool has_avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    if (has_avx2)
+        return avx2;
+#endif
+    return scalar;
+}
+
+
+// what the handlers call
+static inline void vector_add(double* dst, const double* a, const double* b, size_t n) {
+    vector_kernels().add(dst, a, b, n);
+}
+
+static inline void vector_sub(double* dst, const double* a, const double* b, size_t n) {
+    vector_kernels().sub(dst, a, b, n);
+}
+
+static inline void vector_mul(double* dst, const double* a, const double* b, size_t n) {
+    vector_kernels().mul(dst, a, b, n);
+}
+
+static inline void vector_div(double* dst, const double* a, const double* b, size_t n) {
+    vector_kernels().div(dst, a, b, n);
+}
+
+static inline void vector_fill(double* dst, double k, size_t n) {
+    vector_kernels().fill(dst, k, n);
+}
+
+static inline void vector_scale(double* dst, const double* a, double k, size_t n) {
+    vector_kernels().scale(dst, a, k, n);
+}
+
+static inline double vector_dot(const double* a, const double* b, size_t n) {
+    return vector_kernels().dot(a, b, n);
+}
+
+static inline double vector_sum(const double* a, size_t n) {
+    return vector_kernels().sum(a, n);
+}
@@ -1,75 +1,577 @@
 #pragma once
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <limits.h>
+#include <math.h>
 #include "processor.h"
+#include "bytecode.h"
+#include "decoder.h"
 
 
-static void verify_push_pop(unsigned char command, const char* cur, const char* begin) {
-    int where = *(double*)cur;
-    int what = *(double*)(cur + sizeof(double));
+static void verify_push_pop(unsigned char command, unsigned char mode, unsigned char reg, const char* cur, size_t byte,
+                            size_t ram_size) {
+    if (mode > 2)
+        throw verificator_exception(byte,
+                    get_string("%s: wrong addressing mode %d", COMMANDS_NAMES[command], mode));
 
-    if (where == 1 && (what < 0 || what >= __REGISTERS_NUMBER__))
-        throw verificator_exception(begin - cur, 
-                    get_string("%s: wrong register (expected: 0 <= reg < %d, received: %d)", 
-                               COMMANDS_NAMES[command], __REGISTERS_NUMBER__, what));
-    else if (where == 2 && (what < 0 || what >= (int)RAM_SIZE))
-        throw verificator_exception(begin-cur, 
-                    get_string("%s: RAM index (expected: 0 <= index < %zu, received: %d)",
-                               COMMANDS_NAMES[command], RAM_SIZE, what));
+    if (mode == 1 && reg >= __REGISTERS_NUMBER__)
+        throw verificator_exception(byte,
+                    get_string("%s: wrong register (expected: 0 <= reg < %d, received: %d)",
+                               COMMANDS_NAMES[command], __REGISTERS_NUMBER__, reg));
+    else if (mode == 2 && reg > __REGISTERS_NUMBER__)
+        throw verificator_exception(byte,
+                    get_string("%s: wrong base register (expected: 0 <= reg + 1 <= %d, received: %d)",
+                               COMMANDS_NAMES[command], __REGISTERS_NUMBER__, reg));
+    else if (mode == 2) {
+        int shift = read_int(cur);
+        if (shift < 0 || (size_t)shift >= ram_size)
+            throw verificator_exception(byte,
+                        get_string("%s: RAM index (expected: 0 <= index < %zu, received: %d)",
+                                   COMMANDS_NAMES[command], ram_size, shift));
+    }
 }
 
 
-static void verify_jump(unsigned char command, const char* cur, const char* beg, const char* fin) {
-    int ip = *(double*)cur;
-    if (ip < 0 || ip >= fin - beg)
-        throw verificator_exception(beg - cur, 
-                    get_string("%s: invalid pointer (expected: 0 <= ip < %zu, received: %d)", 
-                               COMMANDS_NAMES[command], fin - beg, ip));
+static void verify_jump(unsigned char command, const char* cur, size_t byte, size_t size) {
+    int ip = read_int(cur);
+    if (ip < 0 || (size_t)ip > size)
+        throw verificator_exception(byte,
+                    get_string("%s: invalid pointer (expected: 0 <= ip <= %zu, received: %d)",
+                               COMMANDS_NAMES[command], size, ip));
 }
 
 
-static void verify_draw(const char* cur, const char* beg) {
-    double w = *(double*)cur;
-    double h = *(double*)(cur + sizeof(double));
-    double ndata = *(double*)(cur + 2  * sizeof(double));
+static void verify_draw(const char* cur, size_t byte, size_t ram_size) {
+    int w = read_int(cur);
+    int h = read_int(cur + sizeof(int32_t));
+    int ndata = read_int(cur + 2 * sizeof(int32_t));
 
     if (w < 0 || h < 0 || ndata < 0)
-        throw verificator_exception(beg - cur,
+        throw verificator_exception(byte,
                     "DRAW: all width, height and ndata have to be greater than 0");
-    if (ndata >= RAM_SIZE)
-        throw verificator_exception(beg - cur + 2 * sizeof(double),
-                    get_string("DRAW: ndata greater than RAM_SIZE (RAM_SIZE = %zu)", RAM_SIZE));
+    if ((size_t)ndata >= ram_size)
+        throw verificator_exception(byte,
+                    get_string("DRAW: ndata greater than the RAM size (%zu)", ram_size));
+}
+
+
+static void verify_vector(unsigned char command, const char* cur, size_t byte, size_t ram_size) {
+    const VectorOperands vector = read_vector_operands(command, cur);
+    if (vector.n < 0)
+        throw verificator_exception(byte,
+                    get_string("%s: negative number of cells %d", COMMANDS_NAMES[command], vector.n));
+
+    for (int i = vector_first(command); i <= vector_last(command); ++i) {
+        const int first = vector.first[i];
+        if (first < 0 || (size_t)first + vector.n > ram_size)
+            throw verificator_exception(byte,
+                        get_string("%s: cells [%d, %lld) are not inside RAM of %zu cells", COMMANDS_NAMES[command],
+                                   first, (long long)first + vector.n, ram_size));
+    }
+
+    // element i of dst may be element i of a source, not any other one
+    const int dst = vector.first[0];
+    for (int i = 1; dst >= 0 && i <= vector_last(command); ++i) {
+        const int first = vector.first[i];
+        if (first != dst && first < (long long)dst + vector.n && dst < (long long)first + vector.n)
+            throw verificator_exception(byte,
+                        get_string("%s: dst partly overlaps a source", COMMANDS_NAMES[command]));
+    }
 }
 
 
-static void verify_command(unsigned char command, const char* cur, const char* beg, const char* fin) {
-    if ((size_t)(fin - cur) < sizeof(double) * ARGS_NUMBERS[command])
-        throw verificator_exception(beg - cur, 
-                    get_string("%s: wrong number of arguments (expected %zu)", 
-                               COMMANDS_NAMES[command], ARGS_NUMBERS[command]));
+static void verify_command(const char* cur, const char* beg, const char* fin, size_t ram_size) {
+    const size_t byte = cur - beg;
+    unsigned char command = cur[0], mode = cur[1], reg = cur[2];
+
+    if ((size_t)(fin - cur) < instruction_size(command, mode))
+        throw verificator_exception(byte,
+                    get_string("%s: wrong number of arguments", COMMANDS_NAMES[command]));
+
+    cur += INSTRUCTION_HEADER_SIZE;
 
     if (command == CMD_PUSH || command == CMD_POP)
-        verify_push_pop(command, cur, beg);
-    else if (command == CMD_JMP || 
+        verify_push_pop(command, mode, reg, cur, byte, ram_size);
+    else if (mode || reg)
+        throw verificator_exception(byte,
+                    get_string("%s: mode and register must be 0", COMMANDS_NAMES[command]));
+    else if (command == CMD_JMP ||
              command == CMD_JA || command == CMD_JB || command == CMD_JNE ||
              command == CMD_JAE || command == CMD_JBE || command == CMD_JE ||
-             command == CMD_CALL || command == CMD_FD)
-        verify_jump(command, cur, beg, fin);
+             command == CMD_CALL || command == CMD_FD || command == CMD_RET || command == CMD_LEAVE ||
+             command == CMD_TAILCALL)
+        verify_jump(command, cur, byte, fin - beg);
     else if (command == CMD_DRAW)
-        verify_draw(cur, beg);
+        verify_draw(cur, byte, ram_size);
+    else if (is_vector(command))
+        verify_vector(command, cur, byte, ram_size);
 }
 
 
-static void verify(const char* prog, size_t size) {
-    if (strncmp(prog, SGN, strlen(SGN)))
-        throw verificator_exception(-1, "wrong signature");
+// ram_size: cells of RAM the program runs with, 0 - what its header asks for
+static void verify(const char* prog, size_t size, size_t ram_size = 0) {
+    if (size < BYTECODE_HEADER_SIZE || strncmp(prog, SGN, strlen(SGN)))
+        throw verificator_exception(0, "wrong signature");
+    if ((unsigned char)prog[strlen(SGN)] != BYTECODE_VERSION)
+        throw verificator_exception(strlen(SGN),
+                    get_string("unsupported bytecode version %d (expected %d), the program has to be reassembled",
+                               (unsigned char)prog[strlen(SGN)], BYTECODE_VERSION));
+    if ((unsigned char)prog[RAM_LOG2_OFFSET] > MAX_RAM_LOG2)
+        throw verificator_exception(RAM_LOG2_OFFSET,
+                    get_string("RAM of 2^%d cells is too big (at most 2^%d)",
+                               (unsigned char)prog[RAM_LOG2_OFFSET], MAX_RAM_LOG2));
+    if (!ram_size)
+        ram_size = header_ram_size(prog);
 
-    const char* cur = prog + strlen(SGN);
+    const char* cur = prog + BYTECODE_HEADER_SIZE;
     const char* fin = prog + size;
     while (cur != fin) {
+        if ((size_t)(fin - cur) < INSTRUCTION_HEADER_SIZE)
+            throw verificator_exception(cur - prog, "truncated instruction");
+
         size_t command = *(unsigned char*)cur;
         if (command >= __COMMANDS_NUMBER__)
-            throw verificator_exception(prog - cur, get_string("wrong command's code: %zu", command));
-        ++cur;
-        verify_command(command, cur, prog, fin);
-        cur += sizeof(double) * ARGS_NUMBERS[command];
+            throw verificator_exception(cur - prog, get_string("wrong command's code: %zu", command));
+
+        verify_command(cur, prog, fin, ram_size);
+        cur += instruction_size(command, cur[1]);
     }
 }
+
+
+// Result of StackVerifier::analyze. Only a proven program gets the per instruction data.
+struct StackAnalysis {
+    static constexpr int __UNREACHED__ = INT_MIN;
+
+    bool proven = false;
+    size_t instruction = 0;       // not proven: the instruction the proof failed at and why
+    std::string reason;
+
+    // per instruction: stack depth before it, counted from the frame of its function, and the FD of the
+    // function (-1 - outside of functions)
+    std::vector<int> depth;
+    std::vector<int> function;
+
+    // per FD (index size() for the code outside of functions): slots the frame needs,
+    // does the function return a value (1), nothing (0) or both (2)
+    std::vector<int> frame_size;
+    std::vector<int> returns;
+};
+
+
+// Abstract interpretation of a decoded program over its control-flow graph. The program is proven when
+// the stack depth before every reachable instruction does not depend on the path to it, nothing pops
+// more than its frame holds, locals and arguments are inside the frame and RET, LEAVE and TAILCALL leave
+// exactly what CALL expects; such a program never underflows the stack. Registers and stack values are tracked
+// as intervals on the way, PUSH and POP [reg+shift] whose address stays inside RAM on every path are
+// marked bounded.
+class StackVerifier {
+public:
+    StackVerifier(std::vector<Instruction>& program, size_t ram_size)
+        : program_(program), n_(program.size()), ram_size_(ram_size) {}
+
+    StackAnalysis analyze() {
+        StackAnalysis analysis;
+        try {
+            analyze_();
+        } catch (Unproven_& e) {
+            analysis.instruction = e.instruction;
+            analysis.reason = e.reason;
+            return analysis;
+        }
+
+        for (size_t i = 0; i < n_; ++i) {
+            Instruction& in = program_[i];
+            if ((in.command == CMD_PUSH || in.command == CMD_POP) && in.mode == 2)
+                in.bounded = depth_[i] != StackAnalysis::__UNREACHED__ && bounded_(in, states_[i]);
+        }
+
+        analysis.proven = true;
+        analysis.depth = std::move(depth_);
+        analysis.function = std::move(function_of_);
+        analysis.frame_size = std::move(frame_size_);
+        analysis.returns = std::move(returns_);
+        return analysis;
+    }
+
+private:
+    // joins at a loop head after which the bounds that still move jump to the next threshold
+    static constexpr int WIDENING_DELAY = 3;
+
+    struct Unproven_ {
+        size_t instruction;
+        std::string reason;
+    };
+
+    struct Interval {
+        double lo = -INFINITY;
+        double hi = INFINITY;
+    };
+
+    struct Value {
+        Interval range;
+        int reg = -1;        // the register the value was pushed from, while the register still holds it
+    };
+
+    struct State {
+        std::vector<Value> stack;
+        Interval registers[__REGISTERS_NUMBER__];
+    };
+
+    std::vector<Instruction>& program_;
+    const size_t n_;
+    const size_t ram_size_;
+
+    std::vector<int> depth_;
+    std::vector<int> function_of_;
+    std::vector<int> frame_size_;
+    std::vector<int> returns_;
+
+    std::vector<State> states_;
+    std::vector<int> changes_;
+    std::vector<bool> loop_head_;
+    std::vector<bool> queued_;
+    std::vector<size_t> work_;
+    std::vector<double> thresholds_;
+
+    int nargs_(int function) const {
+        return function < 0 ? 0 : program_[function].nargs;
+    }
+
+    int nlocals_(int function) const {
+        return function < 0 ? 0 : program_[function].nlocals;
+    }
+
+    static bool binary_(unsigned char command) {
+        return command == CMD_ADD || command == CMD_SUB || command == CMD_MUL || command == CMD_DIV ||
+               command == CMD_MOD || command == CMD_POW ||
+               command == CMD_EQ || command == CMD_NE || command == CMD_LT || command == CMD_LE ||
+               command == CMD_GT || command == CMD_GE ||
+               (is_jump(command) && command != CMD_JMP);
+    }
+
+    static bool unary_(unsigned char command) {
+        return command == CMD_ABS || command == CMD_INC || command == CMD_DEC ||
+               command == CMD_SQRT || command == CMD_SQR || command == CMD_SIN || command == CMD_COS ||
+               command == CMD_TG || command == CMD_ARCSIN || command == CMD_ARCCOS || command == CMD_ARCTG ||
+               command == CMD_SH || command == CMD_CH || command == CMD_TH || command == CMD_ARCSH ||
+               command == CMD_ARCCH || command == CMD_ARCTH || command == CMD_LOG || command == CMD_EXP;
+    }
+
+    // values the instruction pops and pushes
+    std::pair<int, int> stack_effect_(const Instruction& in) const {
+        if (binary_(in.command))
+            return is_jump(in.command) ? std::make_pair(2, 0) : std::make_pair(2, 1);
+        if (unary_(in.command))
+            return {1, 1};
+
+        switch (in.command) {
+            case CMD_PUSH: case CMD_IN: case CMD_GET_LOCAL: case CMD_GET_ARG: case CMD_VDOT: case CMD_VSUM:
+                return {0, 1};
+            case CMD_POP: case CMD_OUT: case CMD_SET_LOCAL: case CMD_RET: case CMD_VFILL: case CMD_VSCALE:
+                return {1, 0};
+            case CMD_CALL:
+                return {in.nargs, returns_[in.target - 1] == 1};
+            case CMD_TAILCALL:
+                return {in.nargs, 0};
+            default:
+                return {0, 0};
+        }
+    }
+
+    void check_frame_(size_t i, int offset, int lower) const {
+        const int function = function_of_[i];
+        if (function < 0)
+            throw Unproven_{i, get_string("%s outside of a function", COMMANDS_NAMES[program_[i].command])};
+        if (offset < lower || offset >= nlocals_(function))
+            throw Unproven_{i, get_string("%s: offset %d is outside of the frame",
+                                          COMMANDS_NAMES[program_[i].command], offset)};
+    }
+
+    static Interval constant_(double value) {
+        return isfinite(value) ? Interval{value, value} : Interval{};
+    }
+
+    // bounds computed from bounds: rounding is monotonic, so they hold for every value in between.
+    // Only the full range may hold NaN, whatever produces it from finite bounds makes the full range too.
+    static Interval make_(double lo, double hi) {
+        return isnan(lo) || isnan(hi) ? Interval{} : Interval{lo, hi};
+    }
+
+    // how far the values compared with _EPS may go past the bound, with room for rounding
+    static double slack_(double bound) {
+        return 2 * 1e-6 + fabs(bound) * 1e-15;
+    }
+
+    // what holds for b after the conditional jump comparing it with a went the given way, empty when it
+    // cannot go there. NaN passes the negated comparisons, so only the jumps it fails narrow the full range.
+    static Interval refine_(Interval b, unsigned char command, Interval a, bool taken) {
+        const bool finite = b.lo != -INFINITY || b.hi != INFINITY;
+        switch (command) {
+            case CMD_JB: case CMD_JAE:
+                if (taken == (command == CMD_JB))
+                    b.hi = std::min(b.hi, a.hi);
+                else if (finite)
+                    b.lo = std::max(b.lo, a.lo - slack_(a.lo));
+                break;
+            case CMD_JA: case CMD_JBE:
+                if (taken == (command == CMD_JA))
+                    b.lo = std::max(b.lo, a.lo);
+                else if (finite)
+                    b.hi = std::min(b.hi, a.hi + slack_(a.hi));
+                break;
+            case CMD_JE: case CMD_JNE:
+                if (taken == (command == CMD_JE)) {
+                    b.lo = std::max(b.lo, a.lo - slack_(a.lo));
+                    b.hi = std::min(b.hi, a.hi + slack_(a.hi));
+                }
+                break;
+        }
+        return b;
+    }
+
+    // joins from into into, widen moves the bounds that grow to the next threshold
+    bool merge_(Interval& into, Interval from, bool widen) const {
+        Interval joined = {std::min(into.lo, from.lo), std::max(into.hi, from.hi)};
+        if (joined.lo == into.lo && joined.hi == into.hi)
+            return false;
+
+        if (widen && joined.lo < into.lo) {
+            auto it = std::upper_bound(thresholds_.begin(), thresholds_.end(), joined.lo);
+            joined.lo = it == thresholds_.begin() ? -INFINITY : *(it - 1);
+        }
+        if (widen && joined.hi > into.hi) {
+            auto it = std::lower_bound(thresholds_.begin(), thresholds_.end(), joined.hi);
+            joined.hi = it == thresholds_.end() ? INFINITY : *it;
+        }
+
+        into = joined;
+        return true;
+    }
+
+    bool join_(size_t i, const State& incoming) {
+        State& state = states_[i];
+        const bool widen = loop_head_[i] && changes_[i] >= WIDENING_DELAY;
+        bool changed = false;
+
+        for (int r = 0; r < __REGISTERS_NUMBER__; ++r)
+            changed |= merge_(state.registers[r], incoming.registers[r], widen);
+
+        for (size_t k = 0; k < state.stack.size(); ++k) {
+            changed |= merge_(state.stack[k].range, incoming.stack[k].range, widen);
+            if (state.stack[k].reg != incoming.stack[k].reg && state.stack[k].reg >= 0) {
+                state.stack[k].reg = -1;
+                changed = true;
+            }
+        }
+
+        changes_[i] += changed;
+        return changed;
+    }
+
+    void visit_(size_t i, int function, const State& state) {
+        if (i == n_)
+            return;
+
+        const int depth = state.stack.size();
+        if (depth_[i] == StackAnalysis::__UNREACHED__) {
+            depth_[i] = depth;
+            function_of_[i] = function;
+            states_[i] = state;
+        } else if (depth_[i] != depth || function_of_[i] != function)
+            throw Unproven_{i, "the stack depth depends on the path to the instruction"};
+        else if (!join_(i, state))
+            return;
+
+        if (!queued_[i]) {
+            queued_[i] = true;
+            work_.push_back(i);
+        }
+    }
+
+    static void forget_(State& state, int reg) {
+        for (auto& value : state.stack)
+            if (value.reg == reg || reg < 0)
+                value.reg = -1;
+    }
+
+    void analyze_() {
+        depth_.assign(n_, StackAnalysis::__UNREACHED__);
+        function_of_.assign(n_, -1);
+        frame_size_.assign(n_ + 1, 0);
+        returns_.assign(n_, -1);
+        states_.assign(n_, State{});
+        changes_.assign(n_, 0);
+        loop_head_.assign(n_ + 1, false);
+        queued_.assign(n_, false);
+        thresholds_ = {0, (double)ram_size_};
+
+        for (size_t i = 0; i < n_; ++i) {
+            const Instruction& in = program_[i];
+            // every cycle goes back through one of these, function entries always get the same state
+            if ((is_jump(in.command) || in.command == CMD_FD) && (size_t)in.target <= i)
+                loop_head_[in.target] = true;
+            if (in.command == CMD_PUSH && in.mode == 0 && isfinite(in.value))
+                thresholds_.push_back(in.value);
+            if (in.command != CMD_RET && in.command != CMD_LEAVE)
+                continue;
+
+            int& returns = returns_[in.target - 1];
+            const int value = in.command == CMD_RET;
+            returns = returns == -1 || returns == value ? value : 2;
+        }
+        std::sort(thresholds_.begin(), thresholds_.end());
+
+        // registers start zeroed
+        State entry;
+        for (auto& reg : entry.registers)
+            reg = constant_(0);
+
+        visit_(0, -1, entry);
+        while (!work_.empty()) {
+            const size_t i = work_.back();
+            work_.pop_back();
+            queued_[i] = false;
+            transfer_(i, states_[i]);
+        }
+    }
+
+    void transfer_(size_t i, State state) {
+        const Instruction& in = program_[i];
+        const int function = function_of_[i];
+        const int depth = depth_[i];
+
+        if (in.command == CMD_CALL && returns_[in.target - 1] == 2)
+            throw Unproven_{i, "CALL: the function both returns a value and leaves"};
+
+        auto effect = stack_effect_(in);
+        if (depth < effect.first)
+            throw Unproven_{i, get_string("%s: the stack is empty", COMMANDS_NAMES[in.command])};
+
+        const int next = depth - effect.first + effect.second;
+        int& frame = frame_size_[function < 0 ? n_ : function];
+        frame = std::max(frame, nlocals_(function) + std::max(depth, next) + 1);
+
+        if (in.command == CMD_GET_LOCAL || in.command == CMD_SET_LOCAL)
+            check_frame_(i, in.target, -nargs_(function));
+        else if (in.command == CMD_GET_ARG)
+            check_frame_(i, -1 - in.target, -nargs_(function));
+        else if ((in.command == CMD_RET || in.command == CMD_LEAVE) && in.target - 1 != function)
+            throw Unproven_{i, get_string("%s from another function", COMMANDS_NAMES[in.command])};
+
+        if (in.command == CMD_RET && depth != 1)
+            throw Unproven_{i, "RET: the stack has to hold only the result"};
+        if (in.command == CMD_TAILCALL) {
+            // it returns what the callee returns in place of the current function
+            if (function < 0 || nargs_(function) != in.shift)
+                throw Unproven_{i, "TAILCALL outside of its function"};
+            if (returns_[function] != 1 || returns_[in.target - 1] != 1)
+                throw Unproven_{i, "TAILCALL: both functions have to return a value"};
+            if (depth != in.nargs)
+                throw Unproven_{i, "TAILCALL: the stack has to hold only the arguments"};
+        }
+        if (in.command == CMD_LEAVE && depth != 0)
+            throw Unproven_{i, "LEAVE: the stack has to be empty"};
+
+        std::vector<Value>& stack = state.stack;
+        auto pop = [&stack]() {
+            Value value = stack.back();
+            stack.pop_back();
+            return value;
+        };
+
+        Value a, b;
+        switch (in.command) {
+            case CMD_PUSH:
+                if (in.mode == 0)
+                    stack.push_back({constant_(in.value)});
+                else if (in.mode == 1)
+                    stack.push_back({state.registers[in.reg], in.reg});
+                else
+                    stack.push_back({});
+                break;
+
+            case CMD_POP:
+                a = pop();
+                if (in.mode == 1) {
+                    state.registers[in.reg] = a.range;
+                    forget_(state, in.reg);
+                }
+                break;
+
+            case CMD_ADD:
+                a = pop();
+                b = pop();
+                stack.push_back({make_(b.range.lo + a.range.lo, b.range.hi + a.range.hi)});
+                break;
+
+            case CMD_SUB:
+                a = pop();
+                b = pop();
+                stack.push_back({make_(b.range.lo - a.range.hi, b.range.hi - a.range.lo)});
+                break;
+
+            case CMD_INC: case CMD_DEC:
+                a = pop();
+                stack.push_back({in.command == CMD_INC ? make_(a.range.lo + 1, a.range.hi + 1)
+                                                       : make_(a.range.lo - 1, a.range.hi - 1)});
+                break;
+
+            case CMD_JA: case CMD_JAE: case CMD_JB: case CMD_JBE: case CMD_JE: case CMD_JNE:
+                a = pop();
+                b = pop();
+                break;
+
+            case CMD_EQ: case CMD_NE: case CMD_LT: case CMD_LE: case CMD_GT: case CMD_GE:
+                pop();
+                pop();
+                stack.push_back({{0, 1}});
+                break;
+
+            case CMD_CALL:
+                stack.resize(depth - effect.first);
+                if (effect.second)
+                    stack.push_back({});
+                // the callee may change any register
+                for (auto& reg : state.registers)
+                    reg = Interval{};
+                forget_(state, -1);
+                break;
+
+            default:
+                stack.resize(depth - effect.first);
+                stack.resize(next, Value{});
+                break;
+        }
+
+        if (in.command == CMD_JMP || in.command == CMD_FD)
+            visit_(in.target, function, state);
+        else if (is_jump(in.command)) {
+            for (bool taken : {true, false}) {
+                State edge = state;
+                if (b.reg >= 0) {
+                    Interval& reg = edge.registers[b.reg];
+                    reg = refine_(reg, in.command, a.range, taken);
+                    if (reg.lo > reg.hi)
+                        continue;
+                }
+                visit_(taken ? in.target : i + 1, function, edge);
+            }
+        } else if (in.command == CMD_CALL || in.command == CMD_TAILCALL) {
+            State entry;
+            visit_(in.target, in.target - 1, entry);
+            if (in.command == CMD_CALL)
+                visit_(i + 1, function, state);
+        } else if (in.command != CMD_RET && in.command != CMD_LEAVE && in.command != CMD_END)
+            visit_(i + 1, function, state);
+    }
+
+    // (size_t)x + shift < ram_size_ holds for every x of the base register
+    bool bounded_(const Instruction& in, const State& state) const {
+        if (!in.reg)
+            return true;
+        const Interval base = state.registers[in.reg - 1];
+        return base.lo > -1 && base.hi < (double)ram_size_ - in.shift;
+    }
+};